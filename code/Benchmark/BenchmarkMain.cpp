@@ -0,0 +1,260 @@
+//
+//  BenchmarkMain.cpp
+//
+//	Runs every stress scene at several sizes and prints one JSON object per
+//	run, optionally comparing against a baseline written by an earlier run.
+//
+//	g++ -std=c++17 -O2 -pthread -Icode -o benchmark code/Benchmark/*.cpp code/Scenes/*.cpp code/Scene.cpp code/SceneBatch.cpp code/SceneSnapshot.cpp
+//		code/Math/*.cpp code/Physics/*.cpp code/Physics/Shapes/*.cpp code/Threading/*.cpp code/Profiler/*.cpp
+//		code/Replay/*.cpp
+//
+//	benchmark --out results.jsonl
+//	benchmark --baseline results.jsonl --tolerance 0.1
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "../Scene.h"
+#include "../Clock.h"
+#include "../Scenes/StressScenes.h"
+
+/*
+====================================================
+benchmarkResult_t
+====================================================
+*/
+struct benchmarkResult_t {
+	char scene[ 32 ];
+	int numBodies;
+	int numThreads;
+	int numSteps;
+	double nsPerBodyStep;
+	double avgPairs;
+	double avgContacts;
+	long long peakScratchBytes;	// the most scratch memory a single step used, not what was reserved
+};
+
+static int FormatResult( const benchmarkResult_t & result, char * text, const int maxLength ) {
+	return snprintf( text, maxLength, "{\"scene\":\"%s\",\"bodies\":%d,\"threads\":%d,\"steps\":%d,\"ns_per_body_step\":%.3f,\"avg_pairs\":%.1f,\"avg_contacts\":%.1f,\"peak_scratch_bytes\":%lld}",
+		result.scene, result.numBodies, result.numThreads, result.numSteps, result.nsPerBodyStep, result.avgPairs, result.avgContacts, result.peakScratchBytes );
+}
+
+static bool ParseResult( const char * text, benchmarkResult_t & result ) {
+	const int numParsed = sscanf( text, "{\"scene\":\"%31[^\"]\",\"bodies\":%d,\"threads\":%d,\"steps\":%d,\"ns_per_body_step\":%lf,\"avg_pairs\":%lf,\"avg_contacts\":%lf,\"peak_scratch_bytes\":%lld}",
+		result.scene, &result.numBodies, &result.numThreads, &result.numSteps, &result.nsPerBodyStep, &result.avgPairs, &result.avgContacts, &result.peakScratchBytes );
+	return 8 == numParsed;
+}
+
+static std::vector< benchmarkResult_t > LoadResults( const char * fileName ) {
+	std::vector< benchmarkResult_t > results;
+	FILE * file = fopen( fileName, "rb" );
+	if ( NULL == file ) {
+		return results;
+	}
+
+	char line[ 1024 ];
+	while ( NULL != fgets( line, sizeof( line ), file ) ) {
+		benchmarkResult_t result;
+		if ( ParseResult( line, result ) ) {
+			results.push_back( result );
+		}
+	}
+	fclose( file );
+	return results;
+}
+
+static std::vector< std::string > SplitList( const char * list ) {
+	std::vector< std::string > items;
+	std::string item;
+	for ( const char * c = list; ; c++ ) {
+		if ( *c == ',' || *c == '\0' ) {
+			if ( !item.empty() ) {
+				items.push_back( item );
+			}
+			item.clear();
+			if ( *c == '\0' ) {
+				break;
+			}
+		} else {
+			item += *c;
+		}
+	}
+	return items;
+}
+
+/*
+====================================================
+RunBenchmark
+// Steps until numSteps are done or the time budget runs out, whichever comes first
+====================================================
+*/
+static benchmarkResult_t RunBenchmark( const stressScene_t & stressScene, const int numBodies, const int numThreads, const int numSteps, const float budgetSeconds, const float dt_sec ) {
+	Scene * scene = new Scene( numThreads );
+	stressScene.build( *scene, numBodies );
+
+	long long peakScratchBytes = 0;
+	double sumPairs = 0.0;
+	double sumContacts = 0.0;
+	int64_t updateTime = 0;
+	int step = 0;
+
+	const int64_t budget = int64_t( double( budgetSeconds ) * 1.0e9 );
+	while ( step < numSteps && updateTime < budget ) {
+		const int64_t startTime = GetTimeNanoseconds();
+		scene->Update( dt_sec );
+		updateTime += GetTimeNanoseconds() - startTime;
+		step++;
+
+		const stepStats_t & stats = scene->GetStepStats();
+		sumPairs += stats.numCollisionPairs;
+		sumContacts += stats.numContacts;
+		if ( (long long)stats.scratchBytesUsed > peakScratchBytes ) {
+			peakScratchBytes = (long long)stats.scratchBytesUsed;
+		}
+	}
+
+	benchmarkResult_t result;
+	memset( &result, 0, sizeof( result ) );
+	snprintf( result.scene, sizeof( result.scene ), "%s", stressScene.name );
+	result.numBodies = numBodies;
+	result.numThreads = numThreads;
+	result.numSteps = step;
+	if ( step > 0 ) {
+		result.nsPerBodyStep = double( updateTime ) / ( double( step ) * double( numBodies ) );
+		result.avgPairs = sumPairs / double( step );
+		result.avgContacts = sumContacts / double( step );
+	}
+	result.peakScratchBytes = peakScratchBytes;
+
+	delete scene;
+	return result;
+}
+
+/*
+====================================================
+main
+====================================================
+*/
+int main( int argc, char * argv[] ) {
+	const char * sceneList = NULL;
+	const char * sizeList = "1000,10000,100000";
+	const char * outFileName = NULL;
+	const char * baselineFileName = NULL;
+	int numSteps = 100;
+	int numThreads = 1;
+	float budgetSeconds = 10.0f;
+	float tolerance = 0.1f;
+	const float dt_sec = 1.0f / 60.0f;
+
+	for ( int i = 1; i < argc; i++ ) {
+		const bool hasValue = ( i + 1 < argc );
+		if ( 0 == strcmp( argv[ i ], "--scenes" ) && hasValue ) {
+			sceneList = argv[ ++i ];
+		} else if ( 0 == strcmp( argv[ i ], "--sizes" ) && hasValue ) {
+			sizeList = argv[ ++i ];
+		} else if ( 0 == strcmp( argv[ i ], "--steps" ) && hasValue ) {
+			numSteps = atoi( argv[ ++i ] );
+		} else if ( 0 == strcmp( argv[ i ], "--threads" ) && hasValue ) {
+			numThreads = atoi( argv[ ++i ] );
+		} else if ( 0 == strcmp( argv[ i ], "--budget" ) && hasValue ) {
+			budgetSeconds = (float)atof( argv[ ++i ] );
+		} else if ( 0 == strcmp( argv[ i ], "--out" ) && hasValue ) {
+			outFileName = argv[ ++i ];
+		} else if ( 0 == strcmp( argv[ i ], "--baseline" ) && hasValue ) {
+			baselineFileName = argv[ ++i ];
+		} else if ( 0 == strcmp( argv[ i ], "--tolerance" ) && hasValue ) {
+			tolerance = (float)atof( argv[ ++i ] );
+		} else {
+			printf( "usage: benchmark [--scenes a,b] [--sizes 1000,10000] [--steps N] [--threads N] [--budget seconds]\n" );
+			printf( "                 [--out results.jsonl] [--baseline results.jsonl] [--tolerance 0.1]\n" );
+			printf( "scenes:" );
+			for ( int s = 0; s < g_numStressScenes; s++ ) {
+				printf( " %s", g_stressScenes[ s ].name );
+			}
+			printf( "\n" );
+			return 1;
+		}
+	}
+
+	// a run without steps has no timings, and a zero or NaN in the results would never count as a regression
+	if ( numSteps <= 0 || !( budgetSeconds > 0.0f ) || numThreads < 1 ) {
+		fprintf( stderr, "--steps, --budget and --threads need positive values\n" );
+		return 1;
+	}
+
+	std::vector< const stressScene_t * > stressScenes;
+	if ( NULL == sceneList ) {
+		for ( int i = 0; i < g_numStressScenes; i++ ) {
+			stressScenes.push_back( &g_stressScenes[ i ] );
+		}
+	} else {
+		const std::vector< std::string > names = SplitList( sceneList );
+		for ( int i = 0; i < names.size(); i++ ) {
+			const stressScene_t * stressScene = FindStressScene( names[ i ].c_str() );
+			if ( NULL == stressScene ) {
+				fprintf( stderr, "unknown scene %s\n", names[ i ].c_str() );
+				return 1;
+			}
+			stressScenes.push_back( stressScene );
+		}
+	}
+	const std::vector< std::string > sizes = SplitList( sizeList );
+
+	const std::vector< benchmarkResult_t > baseline = ( NULL != baselineFileName ) ? LoadResults( baselineFileName ) : std::vector< benchmarkResult_t >();
+	if ( NULL != baselineFileName && baseline.empty() ) {
+		fprintf( stderr, "no results in baseline %s\n", baselineFileName );
+		return 1;
+	}
+
+	FILE * outFile = NULL;
+	if ( NULL != outFileName ) {
+		outFile = fopen( outFileName, "wb" );
+		if ( NULL == outFile ) {
+			fprintf( stderr, "failed to open %s\n", outFileName );
+			return 1;
+		}
+	}
+
+	// results go to stdout, the comparison to stderr so stdout stays machine readable
+	int numRegressions = 0;
+	for ( int sceneIndex = 0; sceneIndex < stressScenes.size(); sceneIndex++ ) {
+		for ( int sizeIndex = 0; sizeIndex < sizes.size(); sizeIndex++ ) {
+			const int numBodies = atoi( sizes[ sizeIndex ].c_str() );
+			if ( numBodies <= 0 ) {
+				continue;
+			}
+
+			const benchmarkResult_t result = RunBenchmark( *stressScenes[ sceneIndex ], numBodies, numThreads, numSteps, budgetSeconds, dt_sec );
+
+			char text[ 1024 ];
+			FormatResult( result, text, sizeof( text ) );
+			printf( "%s\n", text );
+			fflush( stdout );
+			if ( NULL != outFile ) {
+				fprintf( outFile, "%s\n", text );
+			}
+
+			for ( int i = 0; i < baseline.size(); i++ ) {
+				const benchmarkResult_t & base = baseline[ i ];
+				if ( 0 != strcmp( base.scene, result.scene ) || base.numBodies != result.numBodies || base.numThreads != result.numThreads ) {
+					continue;
+				}
+
+				// written so a broken baseline entry, zero or NaN, fails the gate instead of passing it
+				const double ratio = result.nsPerBodyStep / base.nsPerBodyStep;
+				const bool isRegression = !( ratio <= 1.0 + tolerance );
+				numRegressions += isRegression ? 1 : 0;
+				fprintf( stderr, "%-10s %7d bodies: %10.1f ns/body/step vs %10.1f baseline (%+.1f%%)%s\n",
+					result.scene, result.numBodies, result.nsPerBodyStep, base.nsPerBodyStep, ( ratio - 1.0 ) * 100.0, isRegression ? "  REGRESSION" : "" );
+			}
+		}
+	}
+
+	if ( NULL != outFile ) {
+		fclose( outFile );
+	}
+	return ( numRegressions > 0 ) ? 2 : 0;
+}
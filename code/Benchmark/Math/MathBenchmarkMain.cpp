@@ -0,0 +1,194 @@
+//
+//  MathBenchmarkMain.cpp
+//
+//	Times the math that Body::Update and ResolveContact lean on, the regular
+//	types against the SimdMath.h ones, for example:
+//
+//	g++ -std=c++17 -O2 -Icode -o mathbenchmark code/Benchmark/Math/*.cpp code/Math/*.cpp
+//	g++ -std=c++17 -O2 -DPHYSICS_SIMD=0 -Icode -o mathbenchmark_scalar code/Benchmark/Math/*.cpp code/Math/*.cpp
+//
+//	mathbenchmark [--count N] [--repeats N]
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "../../Clock.h"
+#include "../../Math/SimdMath.h"
+
+static float RandomFloat( unsigned int & seed ) {
+	seed = seed * 1664525u + 1013904223u;
+	return float( seed >> 8 ) / float( 1 << 24 ) * 2.0f - 1.0f;
+}
+
+/*
+====================================================
+benchData_t
+====================================================
+*/
+struct benchData_t {
+	std::vector< Vec3 > vectors;
+	std::vector< Quat > orientations;
+	std::vector< Mat3 > matrices;
+
+	std::vector< Vec3A > vectorsA;
+	std::vector< QuatA > orientationsA;
+	std::vector< Mat3A > matricesA;
+
+	std::vector< Vec3 > out;
+};
+
+/*
+====================================================
+RunTimed
+// Best of several repeats, in nanoseconds per element
+====================================================
+*/
+template< typename Function >
+static double RunTimed( const int count, const int numRepeats, const Function & function ) {
+	int64_t best = 0;
+	for ( int repeat = 0; repeat < numRepeats; repeat++ ) {
+		const int64_t startTime = GetTimeNanoseconds();
+		function();
+		const int64_t time = GetTimeNanoseconds() - startTime;
+		if ( 0 == repeat || time < best ) {
+			best = time;
+		}
+	}
+	return double( best ) / double( count );
+}
+
+static void PrintResult( const char * name, const double scalarTime, const double simdTime ) {
+	printf( "%-24s %10.3f %10.3f %8.2fx\n", name, scalarTime, simdTime, scalarTime / simdTime );
+}
+
+/*
+====================================================
+main
+====================================================
+*/
+int main( int argc, char * argv[] ) {
+	int count = 1 << 16;
+	int numRepeats = 20;
+	for ( int i = 1; i < argc; i++ ) {
+		const bool hasValue = ( i + 1 < argc );
+		if ( 0 == strcmp( argv[ i ], "--count" ) && hasValue ) {
+			count = atoi( argv[ ++i ] );
+		} else if ( 0 == strcmp( argv[ i ], "--repeats" ) && hasValue ) {
+			numRepeats = atoi( argv[ ++i ] );
+		} else {
+			printf( "usage: mathbenchmark [--count N] [--repeats N]\n" );
+			return 1;
+		}
+	}
+	if ( count <= 0 || numRepeats <= 0 ) {
+		return 1;
+	}
+
+	benchData_t data;
+	unsigned int seed = 1;
+	for ( int i = 0; i < count; i++ ) {
+		const Vec3 vector( RandomFloat( seed ), RandomFloat( seed ), RandomFloat( seed ) );
+		Quat orientation( RandomFloat( seed ), RandomFloat( seed ), RandomFloat( seed ), RandomFloat( seed ) );
+		orientation.Normalize();
+		const Mat3 matrix = orientation.ToMat3() * ( 1.0f + RandomFloat( seed ) * 0.5f );
+
+		data.vectors.push_back( vector );
+		data.orientations.push_back( orientation );
+		data.matrices.push_back( matrix );
+		data.vectorsA.push_back( Vec3A( vector ) );
+		data.orientationsA.push_back( QuatA( orientation ) );
+		data.matricesA.push_back( Mat3A( matrix ) );
+	}
+	data.out.resize( count );
+
+	// every result feeds the sink so nothing gets optimized away
+	float sink = 0.0f;
+	printf( "SIMD: %s  count: %d  repeats: %d\n", PHYSICS_SIMD ? "SSE2" : "off", count, numRepeats );
+	printf( "%-24s %10s %10s %9s\n", "ns/op", "scalar", "simd", "speedup" );
+
+	double scalarTime = RunTimed( count, numRepeats, [ & ] {
+		for ( int i = 1; i < count; i++ ) {
+			sink += data.vectors[ i ].Dot( data.vectors[ i - 1 ] );
+		}
+	} );
+	double simdTime = RunTimed( count, numRepeats, [ & ] {
+		for ( int i = 1; i < count; i++ ) {
+			sink += data.vectorsA[ i ].Dot( data.vectorsA[ i - 1 ] );
+		}
+	} );
+	PrintResult( "Dot", scalarTime, simdTime );
+
+	// the angular impulse terms of ResolveContact
+	scalarTime = RunTimed( count, numRepeats, [ & ] {
+		for ( int i = 1; i < count; i++ ) {
+			data.out[ i ] = ( data.matrices[ i ] * data.vectors[ i ].Cross( data.vectors[ i - 1 ] ) ).Cross( data.vectors[ i ] );
+		}
+	} );
+	simdTime = RunTimed( count, numRepeats, [ & ] {
+		for ( int i = 1; i < count; i++ ) {
+			data.out[ i ] = ( data.matricesA[ i ] * data.vectorsA[ i ].Cross( data.vectorsA[ i - 1 ] ) ).Cross( data.vectorsA[ i ] ).ToVec3();
+		}
+	} );
+	PrintResult( "Mat3 * Cross, Cross", scalarTime, simdTime );
+
+	scalarTime = RunTimed( count, numRepeats, [ & ] {
+		for ( int i = 0; i < count; i++ ) {
+			data.out[ i ] = data.orientations[ i ].RotatePoint( data.vectors[ i ] );
+		}
+	} );
+	simdTime = RunTimed( count, numRepeats, [ & ] {
+		for ( int i = 0; i < count; i++ ) {
+			data.out[ i ] = data.orientationsA[ i ].RotatePoint( data.vectorsA[ i ] ).ToVec3();
+		}
+	} );
+	PrintResult( "RotatePoint", scalarTime, simdTime );
+
+	scalarTime = RunTimed( count, numRepeats, [ & ] {
+		for ( int i = 0; i < count; i++ ) {
+			data.out[ i ] = data.orientations[ 0 ].RotatePoint( data.vectors[ i ] );
+		}
+	} );
+	simdTime = RunTimed( count, numRepeats, [ & ] {
+		RotatePoints( data.orientations[ 0 ], data.vectors.data(), data.out.data(), count );
+	} );
+	PrintResult( "RotatePoints (batched)", scalarTime, simdTime );
+
+	// orientation update of Body::Update
+	scalarTime = RunTimed( count, numRepeats, [ & ] {
+		for ( int i = 1; i < count; i++ ) {
+			Quat orientation = data.orientations[ i ] * data.orientations[ i - 1 ];
+			orientation.Normalize();
+			sink += orientation.w;
+		}
+	} );
+	simdTime = RunTimed( count, numRepeats, [ & ] {
+		for ( int i = 1; i < count; i++ ) {
+			QuatA orientation = data.orientationsA[ i ] * data.orientationsA[ i - 1 ];
+			orientation.Normalize();
+			sink += orientation.MagnitudeSquared();
+		}
+	} );
+	PrintResult( "Quat * Quat, Normalize", scalarTime, simdTime );
+
+	// world space inertia of Body::Update and GetInverseInertiaTensorWorldSpace
+	scalarTime = RunTimed( count, numRepeats, [ & ] {
+		for ( int i = 0; i < count; i++ ) {
+			const Mat3 orientation = data.orientations[ i ].ToMat3();
+			const Mat3 inertia = orientation * data.matrices[ i ] * orientation.Transpose();
+			sink += inertia.Inverse().rows[ 0 ].x;
+		}
+	} );
+	simdTime = RunTimed( count, numRepeats, [ & ] {
+		for ( int i = 0; i < count; i++ ) {
+			const Mat3A orientation = data.orientationsA[ i ].ToMat3();
+			const Mat3A inertia = orientation * data.matricesA[ i ] * orientation.Transpose();
+			sink += inertia.Inverse().m_columns[ 0 ].Dot( Vec3A( 1.0f, 0.0f, 0.0f ) );
+		}
+	} );
+	PrintResult( "ToMat3, R I R^T, Inverse", scalarTime, simdTime );
+
+	printf( "(sink %f)\n", sink + data.out[ count / 2 ].x );
+	return 0;
+}
@@ -0,0 +1,17 @@
+//
+//  Clock.h
+//
+#pragma once
+#include <chrono>
+#include <stdint.h>
+
+/*
+====================================================
+GetTimeNanoseconds
+// Monotonic and portable, 64 bits don't overflow for centuries
+====================================================
+*/
+inline int64_t GetTimeNanoseconds() {
+	const std::chrono::steady_clock::duration time = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration_cast< std::chrono::nanoseconds >( time ).count();
+}
@@ -0,0 +1,276 @@
+//
+//  HeadlessMain.cpp
+//
+//	Steps a scene without a window or a GPU and reports how fast it ran.
+//	Only needs the math, physics and threading code, for example on Linux:
+//
+//	g++ -std=c++17 -O2 -pthread -Icode -o headless code/Headless/*.cpp code/Scenes/*.cpp code/Scene.cpp code/SceneBatch.cpp code/SceneSnapshot.cpp
+//		code/Math/*.cpp code/Physics/*.cpp code/Physics/Shapes/*.cpp code/Threading/*.cpp code/Profiler/*.cpp
+//		code/Replay/*.cpp
+//
+//	headless --scene carpet --bodies 10000 --frames 1000 --dt 0.0166667 --threads 4 --trace trace.json --stats stats.csv
+//
+//	Levels can be baked once and loaded from the binary scene format afterwards:
+//
+//	headless --scene pile --bodies 200000 --frames 0 --export pile.scene
+//	headless --load pile.scene --frames 1000
+//
+//	Many small scenes, like the matches of a game server, step in parallel with a SceneBatch:
+//
+//	headless --scene mixed --bodies 200 --batch 300 --threads 8 --frames 600
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory>
+
+#include "../Scene.h"
+#include "../SceneBatch.h"
+#include "../Clock.h"
+#include "../Profiler/Profiler.h"
+#include "../Profiler/TraceRecorder.h"
+#include "../Scenes/StressScenes.h"
+#include "../Scenes/SceneFile.h"
+#include "../Replay/ReplayRecorder.h"
+
+/*
+====================================================
+PrintUsage
+====================================================
+*/
+static void PrintUsage() {
+	printf( "usage: headless [--scene name] [--bodies N] [--frames N] [--dt seconds] [--threads N] [--trace file.json]\n" );
+	printf( "                [--stats file.csv|file.jsonl] [--load file.scene] [--export file.scene]\n" );
+	printf( "                [--record file.replay] [--reorder steps] [--batch numScenes]\n" );
+	printf( "                [--budget ms]\n" );
+	printf( "scenes: default" );
+	for ( int i = 0; i < g_numStressScenes; i++ ) {
+		printf( " %s", g_stressScenes[ i ].name );
+	}
+	printf( "\n" );
+}
+
+/*
+====================================================
+RunBatch
+// Every scene gets a different body count between half and all of
+// numBodies, so the batch has something to balance
+====================================================
+*/
+static int RunBatch( const stressScene_t * stressScene, const int numScenes, const int numBodies, const int numFrames, const float dt_sec, const int numThreads ) {
+	SceneBatch batch( numThreads );
+	std::vector< Scene * > scenes( numScenes );
+	int totalBodies = 0;
+	for ( int sceneIndex = 0; sceneIndex < numScenes; sceneIndex++ ) {
+		scenes[ sceneIndex ] = new Scene( 1 );
+		if ( NULL == stressScene ) {
+			scenes[ sceneIndex ]->Initialize();
+		} else {
+			stressScene->build( *scenes[ sceneIndex ], numBodies / 2 + ( numBodies / 2 ) * sceneIndex / numScenes );
+		}
+		totalBodies += (int)scenes[ sceneIndex ]->m_bodies.size();
+		batch.AddScene( scenes[ sceneIndex ] );
+	}
+
+	Profiler::Reset();
+	const int64_t startTime = GetTimeNanoseconds();
+	for ( int frame = 0; frame < numFrames; frame++ ) {
+		batch.Update( dt_sec );
+		Profiler::Collect();
+	}
+	const int64_t endTime = GetTimeNanoseconds();
+
+	const double seconds = double( endTime - startTime ) * 1.0e-9;
+	printf( "scenes: %d  bodies: %d  threads: %d  frames: %d  dt: %f\n", numScenes, totalBodies, numThreads, numFrames, dt_sec );
+	if ( numFrames > 0 ) {
+		printf( "batch steps/sec: %.1f  avg ms/batch step: %.4f  scratch KB: %.1f\n", double( numFrames ) / seconds, seconds * 1000.0 / double( numFrames ),
+			double( batch.GetScratchBytes() ) / 1024.0 );
+	}
+
+	for ( int sceneIndex = 0; sceneIndex < numScenes; sceneIndex++ ) {
+		batch.RemoveScene( scenes[ sceneIndex ] );
+		delete scenes[ sceneIndex ];
+	}
+	return 0;
+}
+
+/*
+====================================================
+main
+====================================================
+*/
+int main( int argc, char * argv[] ) {
+	const char * sceneName = "default";
+	int numBodies = 1000;
+	int numFrames = 1000;
+	float dt_sec = 1.0f / 60.0f;
+	int numThreads = 1;
+	const char * traceFileName = NULL;
+	const char * statsFileName = NULL;
+	const char * loadFileName = NULL;
+	const char * exportFileName = NULL;
+	const char * replayFileName = NULL;
+	int reorderInterval = 0;
+	int numBatchScenes = 0;
+	float budgetMilliseconds = 0.0f;
+
+	for ( int i = 1; i < argc; i++ ) {
+		const bool hasValue = ( i + 1 < argc );
+		if ( 0 == strcmp( argv[ i ], "--scene" ) && hasValue ) {
+			sceneName = argv[ ++i ];
+		} else if ( 0 == strcmp( argv[ i ], "--bodies" ) && hasValue ) {
+			numBodies = atoi( argv[ ++i ] );
+		} else if ( 0 == strcmp( argv[ i ], "--frames" ) && hasValue ) {
+			numFrames = atoi( argv[ ++i ] );
+		} else if ( 0 == strcmp( argv[ i ], "--dt" ) && hasValue ) {
+			dt_sec = (float)atof( argv[ ++i ] );
+		} else if ( 0 == strcmp( argv[ i ], "--threads" ) && hasValue ) {
+			numThreads = atoi( argv[ ++i ] );
+		} else if ( 0 == strcmp( argv[ i ], "--trace" ) && hasValue ) {
+			traceFileName = argv[ ++i ];
+		} else if ( 0 == strcmp( argv[ i ], "--stats" ) && hasValue ) {
+			statsFileName = argv[ ++i ];
+		} else if ( 0 == strcmp( argv[ i ], "--load" ) && hasValue ) {
+			loadFileName = argv[ ++i ];
+		} else if ( 0 == strcmp( argv[ i ], "--export" ) && hasValue ) {
+			exportFileName = argv[ ++i ];
+		} else if ( 0 == strcmp( argv[ i ], "--record" ) && hasValue ) {
+			replayFileName = argv[ ++i ];
+		} else if ( 0 == strcmp( argv[ i ], "--reorder" ) && hasValue ) {
+			reorderInterval = atoi( argv[ ++i ] );
+		} else if ( 0 == strcmp( argv[ i ], "--batch" ) && hasValue ) {
+			numBatchScenes = atoi( argv[ ++i ] );
+		} else if ( 0 == strcmp( argv[ i ], "--budget" ) && hasValue ) {
+			budgetMilliseconds = (float)atof( argv[ ++i ] );
+		} else {
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	const bool isDefaultScene = ( 0 == strcmp( sceneName, "default" ) );
+	const stressScene_t * stressScene = FindStressScene( sceneName );
+	if ( ( !isDefaultScene && NULL == stressScene ) || numBodies <= 0 || numFrames < 0 || dt_sec <= 0.0f || reorderInterval < 0 || numBatchScenes < 0 ) {
+		PrintUsage();
+		return 1;
+	}
+	if ( numBatchScenes > 0 ) {
+		return RunBatch( stressScene, numBatchScenes, numBodies, numFrames, dt_sec, numThreads );
+	}
+
+	// owned here so every early return also stops the job system's workers
+	std::unique_ptr< Scene > scene( new Scene( numThreads ) );
+	const int64_t loadStartTime = GetTimeNanoseconds();
+	if ( NULL != loadFileName ) {
+		sceneName = loadFileName;
+		if ( !LoadSceneFile( *scene, loadFileName ) ) {
+			return 1;
+		}
+	} else if ( isDefaultScene ) {
+		scene->Initialize();
+	} else {
+		stressScene->build( *scene, numBodies );
+	}
+	printf( "loaded %d bodies in %.2f ms\n", (int)scene->m_bodies.size(), double( GetTimeNanoseconds() - loadStartTime ) * 1.0e-6 );
+
+	if ( NULL != exportFileName ) {
+		if ( !SaveSceneFile( *scene, exportFileName ) ) {
+			printf( "failed to export %s\n", exportFileName );
+			return 1;
+		}
+		printf( "exported %s\n", exportFileName );
+	}
+
+	StepStatsWriter statsWriter;
+	if ( NULL != statsFileName ) {
+		const size_t length = strlen( statsFileName );
+		const bool isJsonLines = ( length > 6 && 0 == strcmp( statsFileName + length - 6, ".jsonl" ) );
+		if ( !statsWriter.Open( statsFileName, isJsonLines ? StepStatsWriter::FORMAT_JSONL : StepStatsWriter::FORMAT_CSV ) ) {
+			printf( "failed to open %s\n", statsFileName );
+			return 1;
+		}
+		scene->SetStepStatsWriter( &statsWriter );
+	}
+
+	ReplayRecorder replayRecorder;
+	if ( NULL != replayFileName ) {
+		if ( !replayRecorder.Begin( replayFileName ) ) {
+			printf( "failed to open %s\n", replayFileName );
+			return 1;
+		}
+		scene->SetReplayRecorder( &replayRecorder );
+	}
+
+	scene->SetReorderInterval( reorderInterval );
+	Profiler::SetThreadName( "Main" );
+	Profiler::Reset();
+
+	TraceRecorder traceRecorder;
+	if ( NULL != traceFileName && !traceRecorder.Begin( traceFileName ) ) {
+		printf( "failed to open %s\n", traceFileName );
+		return 1;
+	}
+
+	double narrowPhaseMilliseconds = 0.0;
+	double reorderMilliseconds = 0.0;
+	int numDegradedFrames = 0;
+	if ( budgetMilliseconds > 0.0f ) {
+		scene->SetFixedTimeStep( dt_sec, 4 );
+	}
+	const int64_t startTime = GetTimeNanoseconds();
+	for ( int frame = 0; frame < numFrames; frame++ ) {
+		if ( budgetMilliseconds > 0.0f ) {
+			// a frame is one fixed step of wall time, the budget decides how much of it gets simulated and how well
+			scene->StepWithBudget( dt_sec, budgetMilliseconds * 0.001f );
+			if ( 0 != scene->GetDegradations() ) {
+				numDegradedFrames++;
+			}
+		} else {
+			scene->Update( dt_sec );
+		}
+		narrowPhaseMilliseconds += scene->GetStepStats().narrowPhaseMilliseconds;
+		reorderMilliseconds += scene->GetStepStats().reorderMilliseconds;
+
+		// keep the per thread rings from overflowing
+		Profiler::Collect();
+	}
+	const int64_t endTime = GetTimeNanoseconds();
+	traceRecorder.End();
+	replayRecorder.End();
+
+	// the replay still seeks by step, but the steps it dropped can't be looked at
+	int exitCode = 0;
+	if ( replayRecorder.GetNumDroppedFrames() > 0 ) {
+		printf( "error: replay dropped %lld of %lld frames, the writer couldn't keep up\n",
+			(long long)replayRecorder.GetNumDroppedFrames(), (long long)( replayRecorder.GetNumFrames() + replayRecorder.GetNumDroppedFrames() ) );
+		exitCode = 1;
+	}
+
+	if ( 0 == numFrames ) {
+		return exitCode;
+	}
+
+	const double seconds = double( endTime - startTime ) * 1.0e-9;
+	printf( "scene: %s  bodies: %d  threads: %d  frames: %d  dt: %f\n", sceneName, (int)scene->m_bodies.size(), numThreads, numFrames, dt_sec );
+	printf( "steps/sec: %.1f  avg ms/step: %.4f\n", double( numFrames ) / seconds, seconds * 1000.0 / double( numFrames ) );
+	// compare the narrowphase against a run without --reorder to see what the reorders bought
+	printf( "narrowphase ms: %.2f  reorder ms: %.2f\n", narrowPhaseMilliseconds, reorderMilliseconds );
+	if ( budgetMilliseconds > 0.0f ) {
+		printf( "frames over the %.2f ms budget that ran degraded: %d\n", budgetMilliseconds, numDegradedFrames );
+	}
+
+	if ( 0 == Profiler::GetNumZones() ) {
+		printf( "per phase timings need PHYSICS_PROFILER\n" );
+	}
+	printf( "%-16s %10s %10s %10s %10s %10s\n", "zone (ms)", "count", "min", "avg", "max", "p99" );
+	for ( int zoneIndex = 0; zoneIndex < Profiler::GetNumZones(); zoneIndex++ ) {
+		zoneStats_t stats;
+		Profiler::GetZoneStats( zoneIndex, stats );
+		printf( "%-16s %10lld %10.4f %10.4f %10.4f %10.4f\n", stats.name, (long long)stats.count,
+			double( stats.min ) * 1.0e-6, stats.avg * 1.0e-6, double( stats.max ) * 1.0e-6, double( stats.p99 ) * 1.0e-6 );
+	}
+
+	scene->SetStepStatsWriter( NULL );
+	scene->SetReplayRecorder( NULL );
+	return exitCode;
+}
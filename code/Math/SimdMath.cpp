@@ -0,0 +1,53 @@
+//
+//  SimdMath.cpp
+//
+#include "SimdMath.h"
+
+/*
+====================================================
+RotatePoints
+====================================================
+*/
+static_assert( sizeof( Vec3 ) == 3 * sizeof( float ), "RotatePoints expects tightly packed Vec3 arrays" );
+
+void RotatePoints( const Quat & orientation, const Vec3 * points, Vec3 * out, const int num ) {
+	const QuatA rotation( orientation );
+	int i = 0;
+
+#if PHYSICS_SIMD
+	const __m128 qx = _mm_set1_ps( orientation.x );
+	const __m128 qy = _mm_set1_ps( orientation.y );
+	const __m128 qz = _mm_set1_ps( orientation.z );
+	const __m128 qw = _mm_set1_ps( orientation.w );
+	const __m128 two = _mm_set1_ps( 2.0f );
+
+	// every unaligned load reads one float past its point, so stop while a point is left for that
+	for ( ; i + 4 < num; i += 4 ) {
+		__m128 x = _mm_loadu_ps( &points[ i + 0 ].x );
+		__m128 y = _mm_loadu_ps( &points[ i + 1 ].x );
+		__m128 z = _mm_loadu_ps( &points[ i + 2 ].x );
+		__m128 next = _mm_loadu_ps( &points[ i + 3 ].x );
+		_MM_TRANSPOSE4_PS( x, y, z, next );
+
+		// t = 2( q x v ), v' = v + wt + q x t
+		const __m128 tx = _mm_mul_ps( two, _mm_sub_ps( _mm_mul_ps( qy, z ), _mm_mul_ps( qz, y ) ) );
+		const __m128 ty = _mm_mul_ps( two, _mm_sub_ps( _mm_mul_ps( qz, x ), _mm_mul_ps( qx, z ) ) );
+		const __m128 tz = _mm_mul_ps( two, _mm_sub_ps( _mm_mul_ps( qx, y ), _mm_mul_ps( qy, x ) ) );
+		x = _mm_add_ps( _mm_add_ps( x, _mm_mul_ps( qw, tx ) ), _mm_sub_ps( _mm_mul_ps( qy, tz ), _mm_mul_ps( qz, ty ) ) );
+		y = _mm_add_ps( _mm_add_ps( y, _mm_mul_ps( qw, ty ) ), _mm_sub_ps( _mm_mul_ps( qz, tx ), _mm_mul_ps( qx, tz ) ) );
+		z = _mm_add_ps( _mm_add_ps( z, _mm_mul_ps( qw, tz ) ), _mm_sub_ps( _mm_mul_ps( qx, ty ), _mm_mul_ps( qy, tx ) ) );
+
+		// the fourth lane still holds the untouched x of the following point, so the
+		// overlapping stores write back what's there and rotating in place is fine
+		_MM_TRANSPOSE4_PS( x, y, z, next );
+		_mm_storeu_ps( &out[ i + 0 ].x, x );
+		_mm_storeu_ps( &out[ i + 1 ].x, y );
+		_mm_storeu_ps( &out[ i + 2 ].x, z );
+		_mm_storeu_ps( &out[ i + 3 ].x, next );
+	}
+#endif
+
+	for ( ; i < num; i++ ) {
+		out[ i ] = rotation.RotatePoint( Vec3A( points[ i ] ) ).ToVec3();
+	}
+}
@@ -0,0 +1,296 @@
+//
+//  SimdMath.h
+//
+//	16 byte aligned variants of Vec3, Quat and Mat3 for the hot loops. They convert
+//	to and from the regular types and keep the same method names, so code can switch
+//	by changing the types. PHYSICS_SIMD picks SSE2, define it to 0 for the scalar
+//	fallback. Results match the regular types up to rounding, not bit for bit.
+//
+#pragma once
+#include <math.h>
+
+#include "Vector.h"
+#include "Quat.h"
+#include "Matrix.h"
+
+#if !defined( PHYSICS_SIMD )
+	#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+		#define PHYSICS_SIMD 1
+	#else
+		#define PHYSICS_SIMD 0
+	#endif
+#endif
+
+#if PHYSICS_SIMD
+	#include <emmintrin.h>
+	#define SIMD_SHUFFLE( v, x, y, z, w ) _mm_shuffle_ps( ( v ), ( v ), _MM_SHUFFLE( w, z, y, x ) )
+#endif
+
+/*
+====================================================
+Vec3A
+// The fourth lane is always zero
+====================================================
+*/
+class alignas( 16 ) Vec3A {
+public:
+#if PHYSICS_SIMD
+	Vec3A() : m_value( _mm_setzero_ps() ) {}
+	Vec3A( const float x, const float y, const float z ) : m_value( _mm_set_ps( 0.0f, z, y, x ) ) {}
+	explicit Vec3A( const Vec3 & rhs ) : m_value( _mm_set_ps( 0.0f, rhs.z, rhs.y, rhs.x ) ) {}
+	explicit Vec3A( const __m128 value ) : m_value( value ) {}
+
+	Vec3 ToVec3() const {
+		alignas( 16 ) float values[ 4 ];
+		_mm_store_ps( values, m_value );
+		return Vec3( values[ 0 ], values[ 1 ], values[ 2 ] );
+	}
+
+	Vec3A operator + ( const Vec3A & rhs ) const { return Vec3A( _mm_add_ps( m_value, rhs.m_value ) ); }
+	Vec3A operator - ( const Vec3A & rhs ) const { return Vec3A( _mm_sub_ps( m_value, rhs.m_value ) ); }
+	Vec3A operator * ( const float rhs ) const { return Vec3A( _mm_mul_ps( m_value, _mm_set1_ps( rhs ) ) ); }
+	Vec3A operator - () const { return Vec3A( _mm_sub_ps( _mm_setzero_ps(), m_value ) ); }
+
+	float Dot( const Vec3A & rhs ) const {
+		__m128 sum = _mm_mul_ps( m_value, rhs.m_value );
+		sum = _mm_add_ps( sum, SIMD_SHUFFLE( sum, 1, 0, 3, 2 ) );
+		sum = _mm_add_ps( sum, SIMD_SHUFFLE( sum, 2, 3, 0, 1 ) );
+		return _mm_cvtss_f32( sum );
+	}
+
+	Vec3A Cross( const Vec3A & rhs ) const {
+		const __m128 a = SIMD_SHUFFLE( m_value, 1, 2, 0, 3 );
+		const __m128 b = SIMD_SHUFFLE( rhs.m_value, 1, 2, 0, 3 );
+		const __m128 c = _mm_sub_ps( _mm_mul_ps( m_value, b ), _mm_mul_ps( a, rhs.m_value ) );
+		return Vec3A( SIMD_SHUFFLE( c, 1, 2, 0, 3 ) );
+	}
+
+	__m128 m_value;
+#else
+	Vec3A() { m_value[ 0 ] = m_value[ 1 ] = m_value[ 2 ] = m_value[ 3 ] = 0.0f; }
+	Vec3A( const float x, const float y, const float z ) { m_value[ 0 ] = x; m_value[ 1 ] = y; m_value[ 2 ] = z; m_value[ 3 ] = 0.0f; }
+	explicit Vec3A( const Vec3 & rhs ) { m_value[ 0 ] = rhs.x; m_value[ 1 ] = rhs.y; m_value[ 2 ] = rhs.z; m_value[ 3 ] = 0.0f; }
+
+	Vec3 ToVec3() const { return Vec3( m_value[ 0 ], m_value[ 1 ], m_value[ 2 ] ); }
+
+	Vec3A operator + ( const Vec3A & rhs ) const { return Vec3A( m_value[ 0 ] + rhs.m_value[ 0 ], m_value[ 1 ] + rhs.m_value[ 1 ], m_value[ 2 ] + rhs.m_value[ 2 ] ); }
+	Vec3A operator - ( const Vec3A & rhs ) const { return Vec3A( m_value[ 0 ] - rhs.m_value[ 0 ], m_value[ 1 ] - rhs.m_value[ 1 ], m_value[ 2 ] - rhs.m_value[ 2 ] ); }
+	Vec3A operator * ( const float rhs ) const { return Vec3A( m_value[ 0 ] * rhs, m_value[ 1 ] * rhs, m_value[ 2 ] * rhs ); }
+	Vec3A operator - () const { return Vec3A( -m_value[ 0 ], -m_value[ 1 ], -m_value[ 2 ] ); }
+
+	float Dot( const Vec3A & rhs ) const { return m_value[ 0 ] * rhs.m_value[ 0 ] + m_value[ 1 ] * rhs.m_value[ 1 ] + m_value[ 2 ] * rhs.m_value[ 2 ]; }
+
+	Vec3A Cross( const Vec3A & rhs ) const {
+		return Vec3A(
+			m_value[ 1 ] * rhs.m_value[ 2 ] - rhs.m_value[ 1 ] * m_value[ 2 ],
+			rhs.m_value[ 0 ] * m_value[ 2 ] - m_value[ 0 ] * rhs.m_value[ 2 ],
+			m_value[ 0 ] * rhs.m_value[ 1 ] - rhs.m_value[ 0 ] * m_value[ 1 ] );
+	}
+
+	float m_value[ 4 ];
+#endif
+
+	const Vec3A & operator += ( const Vec3A & rhs ) { *this = *this + rhs; return *this; }
+	const Vec3A & operator -= ( const Vec3A & rhs ) { *this = *this - rhs; return *this; }
+	const Vec3A & operator *= ( const float rhs ) { *this = *this * rhs; return *this; }
+
+	float GetLengthSqr() const { return Dot( *this ); }
+	float GetMagnitude() const { return sqrtf( GetLengthSqr() ); }
+	const Vec3A & Normalize() {
+		const float invMagnitude = 1.0f / GetMagnitude();
+		if ( 0.0f * invMagnitude == 0.0f * invMagnitude ) {
+			*this *= invMagnitude;
+		}
+		return *this;
+	}
+};
+
+/*
+====================================================
+Mat3A
+// Stored by columns, so a matrix vector product is three multiply adds
+====================================================
+*/
+class alignas( 16 ) Mat3A {
+public:
+	Mat3A() {}
+	explicit Mat3A( const Mat3 & rhs ) {
+		for ( int i = 0; i < 3; i++ ) {
+			m_columns[ i ] = Vec3A( rhs.rows[ 0 ][ i ], rhs.rows[ 1 ][ i ], rhs.rows[ 2 ][ i ] );
+		}
+	}
+
+	Mat3 ToMat3() const {
+		const Vec3 column0 = m_columns[ 0 ].ToVec3();
+		const Vec3 column1 = m_columns[ 1 ].ToVec3();
+		const Vec3 column2 = m_columns[ 2 ].ToVec3();
+		return Mat3( Vec3( column0.x, column1.x, column2.x ), Vec3( column0.y, column1.y, column2.y ), Vec3( column0.z, column1.z, column2.z ) );
+	}
+
+	Vec3A operator * ( const Vec3A & rhs ) const {
+#if PHYSICS_SIMD
+		const __m128 x = SIMD_SHUFFLE( rhs.m_value, 0, 0, 0, 0 );
+		const __m128 y = SIMD_SHUFFLE( rhs.m_value, 1, 1, 1, 1 );
+		const __m128 z = SIMD_SHUFFLE( rhs.m_value, 2, 2, 2, 2 );
+		return Vec3A( _mm_add_ps( _mm_add_ps( _mm_mul_ps( m_columns[ 0 ].m_value, x ), _mm_mul_ps( m_columns[ 1 ].m_value, y ) ), _mm_mul_ps( m_columns[ 2 ].m_value, z ) ) );
+#else
+		return m_columns[ 0 ] * rhs.m_value[ 0 ] + m_columns[ 1 ] * rhs.m_value[ 1 ] + m_columns[ 2 ] * rhs.m_value[ 2 ];
+#endif
+	}
+
+	Mat3A operator * ( const Mat3A & rhs ) const {
+		Mat3A result;
+		for ( int i = 0; i < 3; i++ ) {
+			result.m_columns[ i ] = *this * rhs.m_columns[ i ];
+		}
+		return result;
+	}
+
+	Mat3A operator * ( const float rhs ) const {
+		Mat3A result;
+		for ( int i = 0; i < 3; i++ ) {
+			result.m_columns[ i ] = m_columns[ i ] * rhs;
+		}
+		return result;
+	}
+
+	Mat3A Transpose() const {
+		Mat3A result;
+#if PHYSICS_SIMD
+		__m128 column0 = m_columns[ 0 ].m_value;
+		__m128 column1 = m_columns[ 1 ].m_value;
+		__m128 column2 = m_columns[ 2 ].m_value;
+		__m128 column3 = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS( column0, column1, column2, column3 );
+		result.m_columns[ 0 ] = Vec3A( column0 );
+		result.m_columns[ 1 ] = Vec3A( column1 );
+		result.m_columns[ 2 ] = Vec3A( column2 );
+#else
+		for ( int i = 0; i < 3; i++ ) {
+			result.m_columns[ i ] = Vec3A( m_columns[ 0 ].m_value[ i ], m_columns[ 1 ].m_value[ i ], m_columns[ 2 ].m_value[ i ] );
+		}
+#endif
+		return result;
+	}
+
+	float Determinant() const { return m_columns[ 0 ].Dot( m_columns[ 1 ].Cross( m_columns[ 2 ] ) ); }
+
+	// the rows of the inverse are the cross products of the columns
+	Mat3A Inverse() const {
+		Mat3A rows;
+		rows.m_columns[ 0 ] = m_columns[ 1 ].Cross( m_columns[ 2 ] );
+		rows.m_columns[ 1 ] = m_columns[ 2 ].Cross( m_columns[ 0 ] );
+		rows.m_columns[ 2 ] = m_columns[ 0 ].Cross( m_columns[ 1 ] );
+		return rows.Transpose() * ( 1.0f / Determinant() );
+	}
+
+	Vec3A m_columns[ 3 ];
+};
+
+/*
+====================================================
+QuatA
+// x y z w in the lanes, the rotations expect a unit quaternion
+====================================================
+*/
+class alignas( 16 ) QuatA {
+public:
+#if PHYSICS_SIMD
+	QuatA() : m_value( _mm_set_ps( 1.0f, 0.0f, 0.0f, 0.0f ) ) {}
+	QuatA( const float x, const float y, const float z, const float w ) : m_value( _mm_set_ps( w, z, y, x ) ) {}
+	explicit QuatA( const Quat & rhs ) : m_value( _mm_set_ps( rhs.w, rhs.z, rhs.y, rhs.x ) ) {}
+	explicit QuatA( const __m128 value ) : m_value( value ) {}
+
+	Quat ToQuat() const {
+		alignas( 16 ) float values[ 4 ];
+		_mm_store_ps( values, m_value );
+		return Quat( values[ 0 ], values[ 1 ], values[ 2 ], values[ 3 ] );
+	}
+
+	QuatA operator * ( const QuatA & rhs ) const {
+		const __m128 negateW = _mm_castsi128_ps( _mm_set_epi32( int( 0x80000000 ), 0, 0, 0 ) );
+		const __m128 a = m_value;
+		const __m128 b = rhs.m_value;
+		const __m128 term0 = _mm_mul_ps( a, SIMD_SHUFFLE( b, 3, 3, 3, 3 ) );
+		const __m128 term1 = _mm_mul_ps( SIMD_SHUFFLE( a, 3, 3, 3, 0 ), SIMD_SHUFFLE( b, 0, 1, 2, 0 ) );
+		const __m128 term2 = _mm_mul_ps( SIMD_SHUFFLE( a, 1, 2, 0, 1 ), SIMD_SHUFFLE( b, 2, 0, 1, 1 ) );
+		const __m128 term3 = _mm_mul_ps( SIMD_SHUFFLE( a, 2, 0, 1, 2 ), SIMD_SHUFFLE( b, 1, 2, 0, 2 ) );
+		const __m128 sum = _mm_xor_ps( _mm_add_ps( term1, term2 ), negateW );
+		return QuatA( _mm_sub_ps( _mm_add_ps( term0, sum ), term3 ) );
+	}
+
+	float MagnitudeSquared() const {
+		__m128 sum = _mm_mul_ps( m_value, m_value );
+		sum = _mm_add_ps( sum, SIMD_SHUFFLE( sum, 1, 0, 3, 2 ) );
+		sum = _mm_add_ps( sum, SIMD_SHUFFLE( sum, 2, 3, 0, 1 ) );
+		return _mm_cvtss_f32( sum );
+	}
+
+	void Normalize() {
+		const float invMagnitude = 1.0f / sqrtf( MagnitudeSquared() );
+		m_value = _mm_mul_ps( m_value, _mm_set1_ps( invMagnitude ) );
+	}
+
+	QuatA Conjugate() const {
+		const __m128 negateXYZ = _mm_castsi128_ps( _mm_set_epi32( 0, int( 0x80000000 ), int( 0x80000000 ), int( 0x80000000 ) ) );
+		return QuatA( _mm_xor_ps( m_value, negateXYZ ) );
+	}
+
+	// v + 2w( q x v ) + 2q x ( q x v ), cheaper than the two quaternion products of Quat::RotatePoint
+	Vec3A RotatePoint( const Vec3A & rhs ) const {
+		const __m128 xyz = _mm_and_ps( m_value, _mm_castsi128_ps( _mm_set_epi32( 0, -1, -1, -1 ) ) );
+		const Vec3A axis( xyz );
+		const Vec3A twiceCross = axis.Cross( rhs ) * 2.0f;
+		const __m128 w = SIMD_SHUFFLE( m_value, 3, 3, 3, 3 );
+		return Vec3A( _mm_add_ps( _mm_add_ps( rhs.m_value, _mm_mul_ps( twiceCross.m_value, w ) ), axis.Cross( twiceCross ).m_value ) );
+	}
+
+	__m128 m_value;
+#else
+	QuatA() { m_value[ 0 ] = m_value[ 1 ] = m_value[ 2 ] = 0.0f; m_value[ 3 ] = 1.0f; }
+	QuatA( const float x, const float y, const float z, const float w ) { m_value[ 0 ] = x; m_value[ 1 ] = y; m_value[ 2 ] = z; m_value[ 3 ] = w; }
+	explicit QuatA( const Quat & rhs ) { m_value[ 0 ] = rhs.x; m_value[ 1 ] = rhs.y; m_value[ 2 ] = rhs.z; m_value[ 3 ] = rhs.w; }
+
+	Quat ToQuat() const { return Quat( m_value[ 0 ], m_value[ 1 ], m_value[ 2 ], m_value[ 3 ] ); }
+
+	QuatA operator * ( const QuatA & rhs ) const {
+		const float * a = m_value;
+		const float * b = rhs.m_value;
+		return QuatA(
+			a[ 0 ] * b[ 3 ] + a[ 3 ] * b[ 0 ] + a[ 1 ] * b[ 2 ] - a[ 2 ] * b[ 1 ],
+			a[ 1 ] * b[ 3 ] + a[ 3 ] * b[ 1 ] + a[ 2 ] * b[ 0 ] - a[ 0 ] * b[ 2 ],
+			a[ 2 ] * b[ 3 ] + a[ 3 ] * b[ 2 ] + a[ 0 ] * b[ 1 ] - a[ 1 ] * b[ 0 ],
+			a[ 3 ] * b[ 3 ] - a[ 0 ] * b[ 0 ] - a[ 1 ] * b[ 1 ] - a[ 2 ] * b[ 2 ] );
+	}
+
+	float MagnitudeSquared() const { return m_value[ 0 ] * m_value[ 0 ] + m_value[ 1 ] * m_value[ 1 ] + m_value[ 2 ] * m_value[ 2 ] + m_value[ 3 ] * m_value[ 3 ]; }
+
+	void Normalize() {
+		const float invMagnitude = 1.0f / sqrtf( MagnitudeSquared() );
+		for ( int i = 0; i < 4; i++ ) {
+			m_value[ i ] *= invMagnitude;
+		}
+	}
+
+	QuatA Conjugate() const { return QuatA( -m_value[ 0 ], -m_value[ 1 ], -m_value[ 2 ], m_value[ 3 ] ); }
+
+	Vec3A RotatePoint( const Vec3A & rhs ) const {
+		const Vec3A axis( m_value[ 0 ], m_value[ 1 ], m_value[ 2 ] );
+		const Vec3A twiceCross = axis.Cross( rhs ) * 2.0f;
+		return rhs + twiceCross * m_value[ 3 ] + axis.Cross( twiceCross );
+	}
+
+	float m_value[ 4 ];
+#endif
+
+	Mat3A ToMat3() const {
+		Mat3A result;
+		result.m_columns[ 0 ] = RotatePoint( Vec3A( 1.0f, 0.0f, 0.0f ) );
+		result.m_columns[ 1 ] = RotatePoint( Vec3A( 0.0f, 1.0f, 0.0f ) );
+		result.m_columns[ 2 ] = RotatePoint( Vec3A( 0.0f, 0.0f, 1.0f ) );
+		return result;
+	}
+};
+
+// Rotates an array of plain Vec3 by one unit quaternion, four points at a time. points and out may be the same array.
+void RotatePoints( const Quat & orientation, const Vec3 * points, Vec3 * out, const int num );
@@ -3,6 +3,22 @@
 //
 #include "Body.h"
 
+const bodyIntegration_t DEFAULT_BODY_INTEGRATION = { 0.0f, false };
+const bodyIntegration_t APPROXIMATE_BODY_INTEGRATION = { 0.05f, true };
+
+/*
+====================================================
+IsIsotropic
+====================================================
+*/
+static bool IsIsotropic(const Mat3& tensor) {
+	const float diagonal = tensor.rows[0].x;
+	return tensor.rows[1].y == diagonal && tensor.rows[2].z == diagonal &&
+		0.0f == tensor.rows[0].y && 0.0f == tensor.rows[0].z &&
+		0.0f == tensor.rows[1].x && 0.0f == tensor.rows[1].z &&
+		0.0f == tensor.rows[2].x && 0.0f == tensor.rows[2].y;
+}
+
 /*
 ====================================================
 Body::Body
@@ -12,7 +28,15 @@ Body::Body() :
 	m_position(0.0f),
 	m_orientation(0.0f, 0.0f, 0.0f, 1.0f),
 	m_linearVelocity(0.0f),
-	m_shape( NULL ) {
+	m_shape( NULL ),
+	m_shapeIndex( -1 ),
+	m_collisionGroup( 1 ),
+	m_collisionMask( 0xffffffff ),
+	m_isSensor( false ),
+	m_isBullet( false ),
+	m_isSwept( true ),
+	m_isSleeping( false ),
+	m_numRestingSteps( 0 ) {
 }
 
 Vec3 Body::GetCenterOfMassWorldSpace() const {
@@ -82,29 +106,46 @@ void Body::ApplyImpulseAngular(const Vec3& angularImpulse) {
 }
 
 
-void Body::Update(const float deltaSecond) {
+void Body::Update(const float deltaSecond, const bodyIntegration_t& integration) {
     m_position += m_linearVelocity * deltaSecond;
 
     Vec3 centerOfMass = GetCenterOfMassWorldSpace();
     Vec3 comToPos = m_position - centerOfMass;
 
-    Mat3 orientation = m_orientation.ToMat3();
-    // Transform the inertia tensor from body space to world space
-    Mat3 inertiaTensor = orientation * m_shape->InertiaTensor() * orientation.Transpose();
-    // Compute the angular acceleration
-    Vec3 acceleration = inertiaTensor.Inverse() * (m_angularVelocity.Cross(inertiaTensor * m_angularVelocity));
-    m_angularVelocity += acceleration * deltaSecond; // angular acceleration times delta time = delta angular velocity
-
+    // An isotropic tensor is the same in every orientation, so w x Iw is always zero
+    const bool isIsotropic = integration.skipIsotropicGyroscopic &&
+        (Shape::SHAPE_SPHERE == m_shape->GetType() || IsIsotropic(m_shape->InertiaTensor()));
+    if (!isIsotropic) {
+        Mat3 orientation = m_orientation.ToMat3();
+        // Transform the inertia tensor from body space to world space
+        Mat3 inertiaTensor = orientation * m_shape->InertiaTensor() * orientation.Transpose();
+        // Compute the angular acceleration
+        Vec3 acceleration = inertiaTensor.Inverse() * (m_angularVelocity.Cross(inertiaTensor * m_angularVelocity));
+        m_angularVelocity += acceleration * deltaSecond; // angular acceleration times delta time = delta angular velocity
+    }
 
     // Update orientation
     // This vector's direction is the axis of rotation, and its magnitude is the angle (in radians)
     Vec3 deltaAngle = m_angularVelocity * deltaSecond;
-    Quat deltaQuat = Quat(deltaAngle, deltaAngle.GetMagnitude());
+    Quat deltaQuat;
+    const float angleSqr = deltaAngle.GetLengthSqr();
+    const bool isSmallAngle = angleSqr < integration.smallAngle * integration.smallAngle;
+    if (isSmallAngle) {
+        // q += 0.5 * w * q * dt, written as a delta quaternion so it can rotate comToPos too.
+        // The normalize below takes care of its length, the angle is off by about angle^3 / 12
+        deltaQuat = Quat(deltaAngle.x * 0.5f, deltaAngle.y * 0.5f, deltaAngle.z * 0.5f, 1.0f);
+    } else {
+        deltaQuat = Quat(deltaAngle, sqrtf(angleSqr));
+    }
     m_orientation = deltaQuat * m_orientation;
     // Normalize the quaternion to prevent numerical drift (quaternions must have magnitude 1)
     m_orientation.Normalize();
 
     // Update the reference position by rotating the offset vector around the center of mass
     // This ensures the position follows the body's rotation although m_position isn’t the center of mass
-    m_position = centerOfMass + deltaQuat.RotatePoint(comToPos);
+    if (comToPos.GetLengthSqr() > 0.0f) {
+        if (isSmallAngle)
+            deltaQuat.Normalize();
+        m_position = centerOfMass + deltaQuat.RotatePoint(comToPos);
+    }
 }
@@ -2,14 +2,25 @@
 //	Body.h
 //
 #pragma once
+#include <stdint.h>
 #include "../Math/Vector.h"
 #include "../Math/Quat.h"
 #include "../Math/Matrix.h"
 #include "../Math/Bounds.h"
 #include "Shapes.h"
 
-#include "../Renderer/model.h"
-#include "../Renderer/shader.h"
+/*
+====================================================
+bodyIntegration_t
+====================================================
+*/
+struct bodyIntegration_t {
+	float smallAngle;				// rotations under this many radians per step use the first order quaternion derivative instead of sin/cos, 0 always rotates exactly
+	bool skipIsotropicGyroscopic;	// the gyroscopic term is zero when the inertia is the same about every axis, like for spheres
+};
+
+extern const bodyIntegration_t DEFAULT_BODY_INTEGRATION;		// exact, the same results as before these options existed
+extern const bodyIntegration_t APPROXIMATE_BODY_INTEGRATION;	// cheaper, for scenes that opt in with Scene::SetBodyIntegration
 
 /*
 ====================================================
@@ -29,6 +40,16 @@ public:
 	float		m_elasticity;
 	float 		m_friction;
 	Shape*		m_shape;
+	int			m_shapeIndex;	// index into the scene's ShapeLibrary, -1 if the shape isn't from a library
+
+	uint32_t	m_collisionGroup;	// bits of the groups the body is in
+	uint32_t	m_collisionMask;	// groups the body collides with, both bodies of a pair have to accept each other
+	bool		m_isSensor;			// only reports overlaps through the scene's sensor events, never collides
+	bool		m_isBullet;			// always gets swept tests, however slow it moves
+	bool		m_isSwept;			// set by the scene every step, false for bodies too slow to need continuous collision
+	bool		m_isSleeping;		// frozen by the scene's time budget until something hits it
+	Vec3		m_restPosition;		// the body stayed close to it for the last m_numRestingSteps steps
+	int			m_numRestingSteps;
 
 	Vec3 GetCenterOfMassWorldSpace() const;
 	Vec3 GetCenterOfMassModelSpace() const;
@@ -42,5 +63,5 @@ public:
 	void ApplyImpulseLinear(const Vec3& linearImpulse);
 	void ApplyImpulseAngular(const Vec3& angularImpulse);
 
-	void Update(const float deltaSecond);
+	void Update(const float deltaSecond, const bodyIntegration_t& integration = DEFAULT_BODY_INTEGRATION);
 };
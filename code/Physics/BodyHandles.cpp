@@ -0,0 +1,140 @@
+//
+//	BodyHandles.cpp
+//
+#include "BodyHandles.h"
+
+/*
+====================================================
+BodyHandleTable::Add
+====================================================
+*/
+bodyHandle_t BodyHandleTable::Add() {
+	int slotIndex = m_firstFreeSlot;
+	if (slotIndex >= 0) {
+		m_firstFreeSlot = m_slots[slotIndex].denseIndex;
+	} else {
+		slotIndex = static_cast<int>(m_slots.size());
+		slot_t slot;
+		slot.generation = 0;
+		m_slots.push_back(slot);
+	}
+
+	slot_t& slot = m_slots[slotIndex];
+	slot.denseIndex = static_cast<int>(m_denseToSlot.size());
+	slot.generation++;
+	if (0 == slot.generation)
+		slot.generation = 1;
+	slot.isUsed = true;
+	m_denseToSlot.push_back(slotIndex);
+
+	bodyHandle_t handle;
+	handle.slot = static_cast<uint32_t>(slotIndex);
+	handle.generation = slot.generation;
+	return handle;
+}
+
+/*
+====================================================
+BodyHandleTable::Reserve
+====================================================
+*/
+void BodyHandleTable::Reserve(const int numBodies) {
+	m_slots.reserve(numBodies);
+	m_denseToSlot.reserve(numBodies);
+}
+
+/*
+====================================================
+BodyHandleTable::Reorder
+====================================================
+*/
+void BodyHandleTable::Reorder(const int* newToOld) {
+	// in place without a copy of the old order: the slots learn their new index while
+	// m_denseToSlot still has the old order, then m_denseToSlot is rebuilt from the slots
+	const int numBodies = GetNumBodies();
+	for (int denseIndex = 0; denseIndex < numBodies; ++denseIndex)
+		m_slots[m_denseToSlot[newToOld[denseIndex]]].denseIndex = denseIndex;
+
+	const int numSlots = static_cast<int>(m_slots.size());
+	for (int slotIndex = 0; slotIndex < numSlots; ++slotIndex) {
+		if (m_slots[slotIndex].isUsed)
+			m_denseToSlot[m_slots[slotIndex].denseIndex] = slotIndex;
+	}
+}
+
+/*
+====================================================
+BodyHandleTable::Remove
+====================================================
+*/
+int BodyHandleTable::Remove(const bodyHandle_t handle) {
+	const int denseIndex = GetDenseIndex(handle);
+	if (denseIndex < 0)
+		return -1;
+
+	// the last body takes the place of the removed one
+	const int lastSlotIndex = m_denseToSlot.back();
+	m_slots[lastSlotIndex].denseIndex = denseIndex;
+	m_denseToSlot[denseIndex] = lastSlotIndex;
+	m_denseToSlot.pop_back();
+
+	slot_t& slot = m_slots[handle.slot];
+	slot.isUsed = false;
+	slot.denseIndex = m_firstFreeSlot;
+	m_firstFreeSlot = static_cast<int>(handle.slot);
+	return denseIndex;
+}
+
+/*
+====================================================
+BodyHandleTable::Clear
+====================================================
+*/
+void BodyHandleTable::Clear() {
+	// keep the slots and their generations so handles from before the clear stay invalid
+	m_firstFreeSlot = -1;
+	for (int slotIndex = static_cast<int>(m_slots.size()) - 1; slotIndex >= 0; --slotIndex) {
+		m_slots[slotIndex].isUsed = false;
+		m_slots[slotIndex].denseIndex = m_firstFreeSlot;
+		m_firstFreeSlot = slotIndex;
+	}
+	m_denseToSlot.clear();
+}
+
+/*
+====================================================
+BodyHandleTable::IsValid
+====================================================
+*/
+bool BodyHandleTable::IsValid(const bodyHandle_t handle) const {
+	if (handle.slot >= m_slots.size())
+		return false;
+
+	const slot_t& slot = m_slots[handle.slot];
+	return slot.isUsed && slot.generation == handle.generation;
+}
+
+/*
+====================================================
+BodyHandleTable::GetDenseIndex
+====================================================
+*/
+int BodyHandleTable::GetDenseIndex(const bodyHandle_t handle) const {
+	if (!IsValid(handle))
+		return -1;
+	return m_slots[handle.slot].denseIndex;
+}
+
+/*
+====================================================
+BodyHandleTable::GetHandle
+====================================================
+*/
+bodyHandle_t BodyHandleTable::GetHandle(const int denseIndex) const {
+	const int slotIndex = m_denseToSlot[denseIndex];
+
+	bodyHandle_t handle;
+	handle.slot = static_cast<uint32_t>(slotIndex);
+	handle.generation = m_slots[slotIndex].generation;
+	return handle;
+}
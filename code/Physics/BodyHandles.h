@@ -0,0 +1,64 @@
+//
+//	BodyHandles.h
+//
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+/*
+====================================================
+bodyHandle_t
+// Stays valid while the body exists no matter how the body array is
+// reordered. The generation tells a removed body apart from a new body
+// that reuses its slot.
+====================================================
+*/
+struct bodyHandle_t {
+	uint32_t slot;
+	uint32_t generation;	// 0 is never handed out
+
+	bool operator == ( const bodyHandle_t & rhs ) const {
+		return ( slot == rhs.slot ) && ( generation == rhs.generation );
+	}
+	bool operator != ( const bodyHandle_t & rhs ) const {
+		return !( *this == rhs );
+	}
+};
+
+const bodyHandle_t INVALID_BODY_HANDLE = { 0xffffffff, 0 };
+
+/*
+====================================================
+BodyHandleTable
+// Maps handles to indices in a dense body array and back. Removing moves
+// the last body into the hole, so the owner of the dense arrays has to
+// do the same swap.
+====================================================
+*/
+class BodyHandleTable {
+public:
+	BodyHandleTable() : m_firstFreeSlot( -1 ) {}
+
+	bodyHandle_t Add();			// the new body goes at the end of the dense array
+	int Remove( const bodyHandle_t handle );	// returns the dense index to fill with the last body, -1 for a stale handle
+	void Clear();
+	void Reserve( const int numBodies );
+	void Reorder( const int * newToOld );	// dense index i takes the body at newToOld[ i ], handles stay valid
+
+	bool IsValid( const bodyHandle_t handle ) const;
+	int GetDenseIndex( const bodyHandle_t handle ) const;	// -1 for a stale handle
+	bodyHandle_t GetHandle( const int denseIndex ) const;
+	int GetNumBodies() const { return static_cast< int >( m_denseToSlot.size() ); }
+	const int * GetDenseToSlot() const { return m_denseToSlot.data(); }
+
+private:
+	struct slot_t {
+		int denseIndex;		// next free slot while the slot isn't in use
+		uint32_t generation;
+		bool isUsed;
+	};
+
+	std::vector< slot_t > m_slots;
+	std::vector< int > m_denseToSlot;
+	int m_firstFreeSlot;
+};
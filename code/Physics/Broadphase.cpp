@@ -2,6 +2,7 @@
 //  Broadphase.cpp
 //
 #include "Broadphase.h"
+#include "../Threading/JobSystem.h"
 
 
 
@@ -11,19 +12,29 @@ int CompareSAP(const void* lhs, const void* rhs) {
 
 	if (left->value < right->value)
 		return -1;
-	return 1;
+	if (left->value > right->value)
+		return 1;
+
+	// break ties on the body id and then min before max, so the order is the same for any sort implementation
+	if (left->id != right->id)
+		return (left->id < right->id) ? -1 : 1;
+	if (left->isMin != right->isMin)
+		return left->isMin ? -1 : 1;
+	return 0;
 }
-void SortBodiesBounds(const Body* bodies, const int numBodies, psuedoBody_t* sortedArray, const float deltaSecond) {
+static void FillBodiesBounds(const Body* bodies, const int begin, const int end, psuedoBody_t* sortedArray, const float deltaSecond) {
 	Vec3 axis = Vec3(1, 1, 1);  // target axis
 	axis.Normalize();
 
-	for (int currentBodyIndex = 0; currentBodyIndex < numBodies; ++currentBodyIndex) {
+	for (int currentBodyIndex = begin; currentBodyIndex < end; ++currentBodyIndex) {
 		const Body& body = bodies[currentBodyIndex];
 		Bounds bounds = body.m_shape->GetBounds(body.m_position, body.m_orientation);
 
-		// expand the bounds by the linear velocity
-		bounds.Expand(bounds.mins + body.m_linearVelocity * deltaSecond);
-		bounds.Expand(bounds.maxs + body.m_linearVelocity * deltaSecond);
+		// expand the bounds by the linear velocity, bodies without continuous collision only need their current bounds
+		if (body.m_isSwept) {
+			bounds.Expand(bounds.mins + body.m_linearVelocity * deltaSecond);
+			bounds.Expand(bounds.maxs + body.m_linearVelocity * deltaSecond);
+		}
 
 		const float epsilon = 0.01f;
 		bounds.Expand(bounds.mins + Vec3(-1, -1, -1) * epsilon);
@@ -37,11 +48,22 @@ void SortBodiesBounds(const Body* bodies, const int numBodies, psuedoBody_t* sor
 		sortedArray[currentBodyIndex * 2 + 1].value = axis.Dot(bounds.maxs);
 		sortedArray[currentBodyIndex * 2 + 1].isMin = false;
 	}
+}
+void SortBodiesBounds(const Body* bodies, const int numBodies, psuedoBody_t* sortedArray, const float deltaSecond, JobSystem* jobSystem) {
+	// every body writes its own two entries, so the bounds can be filled in parallel
+	if (NULL != jobSystem) {
+		jobSystem->ParallelFor(numBodies, 256, [&](int begin, int end) {
+			FillBodiesBounds(bodies, begin, end, sortedArray, deltaSecond);
+		});
+	} else {
+		FillBodiesBounds(bodies, 0, numBodies, sortedArray, deltaSecond);
+	}
 
 	qsort(sortedArray, numBodies * 2, sizeof(psuedoBody_t), CompareSAP);
 }
-void BuildPairs(std::vector<collisionPair_t>& collisionPairs, const psuedoBody_t* sortedBodies, const int numBodies) {
+void BuildPairs(std::vector<collisionPair_t>& collisionPairs, const psuedoBody_t* sortedBodies, const Body* bodies, const int numBodies, const pairFilter_t* filter) {
 	collisionPairs.clear();
+	const IgnoredPairs* ignoredPairs = (NULL != filter && !filter->ignoredPairs->IsEmpty()) ? filter->ignoredPairs : NULL;
 
 	// now that the bodies are sorted, build the collision pairs
 	const int doubleNumBodies = numBodies * 2;
@@ -60,17 +82,24 @@ void BuildPairs(std::vector<collisionPair_t>& collisionPairs, const psuedoBody_t
 			if (currentBody.isMin == false)
 				continue;
 
+			// filtered pairs never reach the narrowphase
+			if (!ShouldCollide(bodies[targetBody.id], bodies[currentBody.id]))
+				continue;
+			if (NULL != ignoredPairs && ignoredPairs->Contains(filter->bodySlots[targetBody.id], filter->bodySlots[currentBody.id]))
+				continue;
+
 			// create a new pair
 			pair.b = currentBody.id;
 			collisionPairs.push_back(pair);
 		}
 	}
 }
-void SweepAndPrune1D(const Body* bodies, const int numBodies, std::vector<collisionPair_t>& finalPairs, const float deltaSecond) {
-	psuedoBody_t* sortedBodies = reinterpret_cast<psuedoBody_t*>(alloca(sizeof(psuedoBody_t) * numBodies * 2));
+void SweepAndPrune1D(const Body* bodies, const int numBodies, std::vector<collisionPair_t>& finalPairs, const float deltaSecond, std::vector<psuedoBody_t>& sortedBodies, JobSystem* jobSystem, const pairFilter_t* filter) {
+	// the caller keeps the sorted bounds around, large scenes would overflow the stack
+	sortedBodies.resize(numBodies * 2);
 
-	SortBodiesBounds(bodies, numBodies, sortedBodies, deltaSecond);
-	BuildPairs(finalPairs, sortedBodies, numBodies);
+	SortBodiesBounds(bodies, numBodies, sortedBodies.data(), deltaSecond, jobSystem);
+	BuildPairs(finalPairs, sortedBodies.data(), bodies, numBodies, filter);
 }
 
 
@@ -79,7 +108,7 @@ void SweepAndPrune1D(const Body* bodies, const int numBodies, std::vector<collis
 BroadPhase
 ====================================================
 */
-void BroadPhase( const Body * bodies, const int num, std::vector< collisionPair_t > & finalPairs, const float deltaSecond ) {
+void BroadPhase( const Body * bodies, const int num, std::vector< collisionPair_t > & finalPairs, const float deltaSecond, std::vector< psuedoBody_t > & sortedBodies, JobSystem * jobSystem, const pairFilter_t * filter ) {
 	finalPairs.clear();
-	SweepAndPrune1D(bodies, num, finalPairs, deltaSecond);
+	SweepAndPrune1D(bodies, num, finalPairs, deltaSecond, sortedBodies, jobSystem, filter);
 }
@@ -3,8 +3,10 @@
 //
 #pragma once
 #include "Body.h"
+#include "CollisionFilter.h"
 #include <vector>
 
+class JobSystem;
 
 struct collisionPair_t {
 	int a;
@@ -25,7 +27,8 @@ struct psuedoBody_t {
 };
 
 int CompareSAP(const void* lhs, const void* rhs);
-void SortBodiesBounds(const Body* bodies, const int numBodies, psuedoBody_t* sortedArray, const float deltaSecond);
-void BuildPairs(std::vector<collisionPair_t>& collisionPairs, const psuedoBody_t* sortedBodies, const int numBodies);
-void SweepAndPrune1D(const Body* bodies, const int numBodies, std::vector<collisionPair_t>& finalPairs, const float deltaSecond);
-void BroadPhase( const Body * bodies, const int numBodies, std::vector< collisionPair_t > & finalPairs, const float deltaSecond);
+void SortBodiesBounds(const Body* bodies, const int numBodies, psuedoBody_t* sortedArray, const float deltaSecond, JobSystem* jobSystem = NULL);
+// Pairs that ShouldCollide rejects or that the filter ignores are never emitted
+void BuildPairs(std::vector<collisionPair_t>& collisionPairs, const psuedoBody_t* sortedBodies, const Body* bodies, const int numBodies, const pairFilter_t* filter = NULL);
+void SweepAndPrune1D(const Body* bodies, const int numBodies, std::vector<collisionPair_t>& finalPairs, const float deltaSecond, std::vector<psuedoBody_t>& sortedBodies, JobSystem* jobSystem = NULL, const pairFilter_t* filter = NULL);
+void BroadPhase( const Body * bodies, const int numBodies, std::vector< collisionPair_t > & finalPairs, const float deltaSecond, std::vector< psuedoBody_t > & sortedBodies, JobSystem * jobSystem = NULL, const pairFilter_t * filter = NULL );
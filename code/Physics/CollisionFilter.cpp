@@ -0,0 +1,60 @@
+//
+//	CollisionFilter.cpp
+//
+#include "CollisionFilter.h"
+#include <algorithm>
+
+/*
+====================================================
+IgnoredPairs::MakeKey
+====================================================
+*/
+uint64_t IgnoredPairs::MakeKey(const uint32_t slotA, const uint32_t slotB) {
+	const uint32_t first = (slotA < slotB) ? slotA : slotB;
+	const uint32_t second = (slotA < slotB) ? slotB : slotA;
+	return (static_cast<uint64_t>(first) << 32) | second;
+}
+
+/*
+====================================================
+IgnoredPairs::Add
+====================================================
+*/
+void IgnoredPairs::Add(const uint32_t slotA, const uint32_t slotB) {
+	const uint64_t key = MakeKey(slotA, slotB);
+	std::vector<uint64_t>::iterator it = std::lower_bound(m_keys.begin(), m_keys.end(), key);
+	if (it == m_keys.end() || *it != key)
+		m_keys.insert(it, key);
+}
+
+/*
+====================================================
+IgnoredPairs::Remove
+====================================================
+*/
+void IgnoredPairs::Remove(const uint32_t slotA, const uint32_t slotB) {
+	const uint64_t key = MakeKey(slotA, slotB);
+	std::vector<uint64_t>::iterator it = std::lower_bound(m_keys.begin(), m_keys.end(), key);
+	if (it != m_keys.end() && *it == key)
+		m_keys.erase(it);
+}
+
+/*
+====================================================
+IgnoredPairs::RemoveSlot
+====================================================
+*/
+void IgnoredPairs::RemoveSlot(const uint32_t slot) {
+	m_keys.erase(std::remove_if(m_keys.begin(), m_keys.end(), [slot](const uint64_t key) {
+		return static_cast<uint32_t>(key >> 32) == slot || static_cast<uint32_t>(key) == slot;
+	}), m_keys.end());
+}
+
+/*
+====================================================
+IgnoredPairs::Contains
+====================================================
+*/
+bool IgnoredPairs::Contains(const uint32_t slotA, const uint32_t slotB) const {
+	return std::binary_search(m_keys.begin(), m_keys.end(), MakeKey(slotA, slotB));
+}
@@ -0,0 +1,54 @@
+//
+//	CollisionFilter.h
+//
+#pragma once
+#include "Body.h"
+#include <stdint.h>
+#include <vector>
+
+/*
+====================================================
+IgnoredPairs
+// Pairs of bodies that never collide, keyed by handle slot so the list
+// survives bodies moving around in the dense array
+====================================================
+*/
+class IgnoredPairs {
+public:
+	void Add( const uint32_t slotA, const uint32_t slotB );
+	void Remove( const uint32_t slotA, const uint32_t slotB );
+	void RemoveSlot( const uint32_t slot );		// drops every pair of a removed body
+	void Clear() { m_keys.clear(); }
+
+	bool IsEmpty() const { return m_keys.empty(); }
+	bool Contains( const uint32_t slotA, const uint32_t slotB ) const;
+
+private:
+	static uint64_t MakeKey( const uint32_t slotA, const uint32_t slotB );
+
+	std::vector< uint64_t > m_keys;	// sorted
+};
+
+/*
+====================================================
+pairFilter_t
+====================================================
+*/
+struct pairFilter_t {
+	const IgnoredPairs * ignoredPairs;
+	const int * bodySlots;	// handle slot of every dense body index
+};
+
+/*
+====================================================
+ShouldCollide
+// Both bodies have to accept the group of the other one, at least one of them has to move
+// and sensors don't sense each other
+====================================================
+*/
+inline bool ShouldCollide( const Body & bodyA, const Body & bodyB ) {
+	if ( ( 0.0f == bodyA.m_invMass && 0.0f == bodyB.m_invMass ) || ( bodyA.m_isSensor && bodyB.m_isSensor ) ) {
+		return false;
+	}
+	return ( 0 != ( bodyA.m_collisionGroup & bodyB.m_collisionMask ) ) && ( 0 != ( bodyB.m_collisionGroup & bodyA.m_collisionMask ) );
+}
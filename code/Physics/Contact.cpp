@@ -88,15 +88,3 @@ void ResolveContact(contact_t& contact) {
 		bodyB->m_position -= vectorBtwTwoContactPoints * proportionOfB;
 	}
 }
-
-int CompareContacts(const void* contactA, const void* contactB) {
-	contact_t a = *reinterpret_cast<const contact_t*>(contactA);
-	contact_t b = *reinterpret_cast<const contact_t*>(contactB);
-
-	if (a.timeOfImpact < b.timeOfImpact)
-		return -1;
-	else if (a.timeOfImpact == b.timeOfImpact)
-		return 0;
-	else
-		return 1;
-}
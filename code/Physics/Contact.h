@@ -3,8 +3,15 @@
 //
 #pragma once
 #include "Body.h"
+#include <stdint.h>
+#include <string.h>
 
-
+/*
+====================================================
+contact_t
+// The full detail of a contact, only ResolveContact reads it
+====================================================
+*/
 struct contact_t {
 	Vec3 ptOnA_WorldSpace;
 	Vec3 ptOnB_WorldSpace;
@@ -19,5 +26,26 @@ struct contact_t {
 	Body * bodyB;
 };
 
+/*
+====================================================
+contactKey_t
+// What the contact sort moves around, the time of impact above the index
+// of the contact_t. Sorting the keys orders the contacts by time of impact
+// and equal times by index.
+====================================================
+*/
+typedef uint64_t contactKey_t;
+
+inline contactKey_t MakeContactKey( const float timeOfImpact, const int contactIndex ) {
+	// the bits of a non-negative float sort like the float
+	const float time = ( timeOfImpact > 0.0f ) ? timeOfImpact : 0.0f;
+	uint32_t timeBits;
+	memcpy( &timeBits, &time, sizeof( timeBits ) );
+	return ( static_cast< uint64_t >( timeBits ) << 32 ) | static_cast< uint32_t >( contactIndex );
+}
+
+inline int GetContactIndex( const contactKey_t key ) {
+	return static_cast< int >( key & 0xffffffff );
+}
+
 void ResolveContact( contact_t & contact );
-int CompareContacts(const void* contactA, const void* contactB);
@@ -3,6 +3,9 @@
 //
 #include "Intersections.h"
 #include "GJK.h"
+#include "Shapes/ShapeHeightfield.h"
+#include <algorithm>
+#include <math.h>
 
 
 
@@ -91,6 +94,105 @@ bool SphereSphereDynamic(const ShapeSphere* shapeA, const ShapeSphere* shapeB, c
 
 
 
+/*
+====================================================
+SphereHeightfield
+// Contact of a sphere with a terrain at their current positions, in world space
+====================================================
+*/
+static bool SphereHeightfield(const Body& sphereBody, const Body& terrainBody, Vec3& pointOnSphere, Vec3& pointOnTerrain, Vec3& normal, float& separation) {
+	const float radius = static_cast<const ShapeSphere*>(sphereBody.m_shape)->m_radius;
+	const ShapeHeightfield* heightfield = static_cast<const ShapeHeightfield*>(terrainBody.m_shape);
+
+	const Vec3 localCenter = terrainBody.m_orientation.Inverse().RotatePoint(sphereBody.m_position - terrainBody.m_position);
+	Vec3 localPoint;
+	Vec3 localNormal;
+	if (!heightfield->SphereContact(localCenter, radius, localPoint, localNormal, separation))
+		return false;
+
+	normal = terrainBody.m_orientation.RotatePoint(localNormal);
+	pointOnTerrain = terrainBody.m_position + terrainBody.m_orientation.RotatePoint(localPoint);
+	pointOnSphere = sphereBody.m_position - normal * radius;
+	return true;
+}
+
+/*
+====================================================
+SphereHeightfieldDynamic
+// The terrain is static, very fast spheres take the capped number of steps
+====================================================
+*/
+static bool SphereHeightfieldDynamic(const Body& sphereBody, const Body& terrainBody, const float deltaTime, Vec3& pointOnSphere, Vec3& pointOnTerrain,
+	Vec3& normal, float& separation, float& timeOfImpact) {
+	const float radius = static_cast<const ShapeSphere*>(sphereBody.m_shape)->m_radius;
+	const ShapeHeightfield* heightfield = static_cast<const ShapeHeightfield*>(terrainBody.m_shape);
+
+	const Quat inverseOrientation = terrainBody.m_orientation.Inverse();
+	const Vec3 localCenter = inverseOrientation.RotatePoint(sphereBody.m_position - terrainBody.m_position);
+	const Vec3 localDisplacement = inverseOrientation.RotatePoint(sphereBody.m_linearVelocity * deltaTime);
+	const int maxSteps = 16;
+	float t;
+	Vec3 localPoint;
+	Vec3 localNormal;
+	if (!heightfield->SweepSphere(localCenter, radius, localDisplacement, maxSteps, t, localPoint, localNormal, separation))
+		return false;
+
+	timeOfImpact = t * deltaTime;
+	normal = terrainBody.m_orientation.RotatePoint(localNormal);
+	pointOnTerrain = terrainBody.m_position + terrainBody.m_orientation.RotatePoint(localPoint);
+	pointOnSphere = sphereBody.m_position + sphereBody.m_linearVelocity * timeOfImpact - normal * radius;
+	return true;
+}
+
+/*
+====================================================
+IntersectSphereHeightfield
+// Either body can be the terrain, a deltaTime of zero only tests the current positions
+====================================================
+*/
+static bool IntersectSphereHeightfield(Body* bodyA, Body* bodyB, const float deltaTime, const bodyIntegration_t& integration, contact_t& contact) {
+	const bool isTerrainA = (ShapeHeightfield::SHAPE_HEIGHTFIELD == bodyA->m_shape->GetType());
+	const Body* sphereBody = isTerrainA ? bodyB : bodyA;
+	const Body* terrainBody = isTerrainA ? bodyA : bodyB;
+
+	Vec3 pointOnSphere;
+	Vec3 pointOnTerrain;
+	Vec3 normal;
+	float timeOfImpact = 0.0f;
+	if (deltaTime > 0.0f) {
+		if (!SphereHeightfieldDynamic(*sphereBody, *terrainBody, deltaTime, pointOnSphere, pointOnTerrain, normal, contact.separationDistance, timeOfImpact))
+			return false;
+	} else if (!SphereHeightfield(*sphereBody, *terrainBody, pointOnSphere, pointOnTerrain, normal, contact.separationDistance)) {
+		return false;
+	}
+
+	// the normal points from B to A, it came out pointing from the terrain to the sphere
+	contact.ptOnA_WorldSpace = isTerrainA ? pointOnTerrain : pointOnSphere;
+	contact.ptOnB_WorldSpace = isTerrainA ? pointOnSphere : pointOnTerrain;
+	contact.normal = isTerrainA ? normal * -1.0f : normal;
+	contact.timeOfImpact = timeOfImpact;
+
+	if (timeOfImpact > 0.0f) {
+		Body futureA = *bodyA;
+		Body futureB = *bodyB;
+		futureA.Update(timeOfImpact, integration);
+		futureB.Update(timeOfImpact, integration);
+		contact.ptOnA_LocalSpace = futureA.WorldSpaceToBodySpace(contact.ptOnA_WorldSpace);
+		contact.ptOnB_LocalSpace = futureB.WorldSpaceToBodySpace(contact.ptOnB_WorldSpace);
+	} else {
+		contact.ptOnA_LocalSpace = bodyA->WorldSpaceToBodySpace(contact.ptOnA_WorldSpace);
+		contact.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace(contact.ptOnB_WorldSpace);
+	}
+	return true;
+}
+
+static bool IsSphereHeightfield(const Body* bodyA, const Body* bodyB) {
+	const Shape::shapeType_t typeA = bodyA->m_shape->GetType();
+	const Shape::shapeType_t typeB = bodyB->m_shape->GetType();
+	return (Shape::SHAPE_SPHERE == typeA && ShapeHeightfield::SHAPE_HEIGHTFIELD == typeB) ||
+		(ShapeHeightfield::SHAPE_HEIGHTFIELD == typeA && Shape::SHAPE_SPHERE == typeB);
+}
+
 /*
 ====================================================
 Intersect
@@ -100,22 +202,33 @@ bool Intersect( Body *bodyA, Body *bodyB, contact_t &contact ) {
 	contact.bodyA = bodyA;
 	contact.bodyB = bodyB;
 
-	const Vec3 vectorAB = bodyB->m_position - bodyA->m_position;
-	contact.normal = vectorAB;
-	contact.normal.Normalize();
+	if (IsSphereHeightfield(bodyA, bodyB))
+		return IntersectSphereHeightfield(bodyA, bodyB, 0.0f, DEFAULT_BODY_INTEGRATION, contact);
+
+	if (bodyA->m_shape->GetType() != Shape::SHAPE_SPHERE || bodyB->m_shape->GetType() != Shape::SHAPE_SPHERE)
+		return false;
 
 	const ShapeSphere* sphereA = (const ShapeSphere*)bodyA->m_shape;
 	const ShapeSphere* sphereB = (const ShapeSphere*)bodyB->m_shape;
 
-	contact.ptOnA_WorldSpace = bodyA->m_position + contact.normal * sphereA->m_radius;
-	contact.ptOnB_WorldSpace = bodyB->m_position - contact.normal * sphereB->m_radius;
-
+	const Vec3 vectorAB = bodyB->m_position - bodyA->m_position;
 	const float radiusAB = sphereA->m_radius + sphereB->m_radius;
 	const float lengthSquared = vectorAB.GetLengthSqr();
-	if (lengthSquared <= (radiusAB * radiusAB))
-		return true;
+	if (lengthSquared > (radiusAB * radiusAB))
+		return false;
 
-	return false;
+	Vec3 directionAB = vectorAB;
+	directionAB.Normalize();
+	contact.ptOnA_WorldSpace = bodyA->m_position + directionAB * sphereA->m_radius;
+	contact.ptOnB_WorldSpace = bodyB->m_position - directionAB * sphereB->m_radius;
+	contact.ptOnA_LocalSpace = bodyA->WorldSpaceToBodySpace(contact.ptOnA_WorldSpace);
+	contact.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace(contact.ptOnB_WorldSpace);
+
+	// same convention as the swept test, the normal points from B to A
+	contact.normal = directionAB * -1.0f;
+	contact.separationDistance = sqrtf(lengthSquared) - radiusAB;
+	contact.timeOfImpact = 0.0f;
+	return true;
 }
 
 /*
@@ -123,10 +236,13 @@ bool Intersect( Body *bodyA, Body *bodyB, contact_t &contact ) {
 Intersect
 ====================================================
 */
-bool Intersect( Body * bodyA, Body * bodyB, const float deltaTime, contact_t & contact ) {
+bool Intersect( Body * bodyA, Body * bodyB, const float deltaTime, contact_t & contact, const bodyIntegration_t & integration ) {
 	contact.bodyA = bodyA;
 	contact.bodyB = bodyB;
 
+	if (IsSphereHeightfield(bodyA, bodyB))
+		return IntersectSphereHeightfield(bodyA, bodyB, deltaTime, integration, contact);
+
 	if (bodyA->m_shape->GetType() == Shape::SHAPE_SPHERE && bodyB->m_shape->GetType() == Shape::SHAPE_SPHERE) {
 		const ShapeSphere* sphereA = reinterpret_cast<const ShapeSphere*>(bodyA->m_shape);
 		const ShapeSphere* sphereB = reinterpret_cast<const ShapeSphere*>(bodyB->m_shape);
@@ -138,20 +254,19 @@ bool Intersect( Body * bodyA, Body * bodyB, const float deltaTime, contact_t & c
 		Vec3 velB = bodyB->m_linearVelocity;
 
 		if (SphereSphereDynamic(sphereA, sphereB, posA, posB, velA, velB, deltaTime, contact.ptOnA_WorldSpace, contact.ptOnB_WorldSpace, contact.timeOfImpact)) {
-			// step bodies forward to get local space collision points
-			bodyA->Update(contact.timeOfImpact);
-			bodyB->Update(contact.timeOfImpact);
+			// step copies of the bodies forward to get local space collision points,
+			// the bodies themselves are left untouched so pairs can be tested concurrently
+			Body futureA = *bodyA;
+			Body futureB = *bodyB;
+			futureA.Update(contact.timeOfImpact, integration);
+			futureB.Update(contact.timeOfImpact, integration);
 			
 			// convert world space contacts to local space
-			contact.ptOnA_LocalSpace = bodyA->WorldSpaceToBodySpace(contact.ptOnA_WorldSpace);
-			contact.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace(contact.ptOnB_WorldSpace);
+			contact.ptOnA_LocalSpace = futureA.WorldSpaceToBodySpace(contact.ptOnA_WorldSpace);
+			contact.ptOnB_LocalSpace = futureB.WorldSpaceToBodySpace(contact.ptOnB_WorldSpace);
 
-			contact.normal = bodyA->m_position - bodyB->m_position;
+			contact.normal = futureA.m_position - futureB.m_position;
 			contact.normal.Normalize();
-
-			// unwind time step
-			bodyA->Update(-contact.timeOfImpact);
-			bodyB->Update(-contact.timeOfImpact);
 			
 			// calculate the separation distance
 			Vec3 vectorAtoB = bodyB->m_position - bodyA->m_position;
@@ -7,5 +7,7 @@
 bool RaySphere(const Vec3& rayStart, const Vec3& rayDirection, const Vec3& sphereCenter, const float sphereRadius, float& time1, float& time2);
 bool SphereSphereDynamic(const ShapeSphere* shapeA, const ShapeSphere* shapeB, const Vec3& positionA, const Vec3& positionB, const Vec3& velocityA, const Vec3& velocityB,
 						 const float deltaTime, Vec3& pointOnA, Vec3& pointOnB, float& timeOfImpact);
+// Overlap at the current positions only, the contact is at time zero
 bool Intersect( Body * bodyA, Body * bodyB, contact_t & contact );
-bool Intersect( Body * bodyA, Body * bodyB, const float dt, contact_t & contact );
+// Swept over dt, the contact is at the time of impact. The bodies are integrated to it the way the scene steps them
+bool Intersect( Body * bodyA, Body * bodyB, const float dt, contact_t & contact, const bodyIntegration_t & integration = DEFAULT_BODY_INTEGRATION );
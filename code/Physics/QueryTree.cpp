@@ -0,0 +1,328 @@
+//
+//	QueryTree.cpp
+//
+#include "QueryTree.h"
+#include "Intersections.h"
+#include "../Math/SimdMath.h"
+#include <algorithm>
+
+/*
+====================================================
+QueryTree::Build
+====================================================
+*/
+void QueryTree::Build(const Body* bodies, const int numBodies) {
+	m_nodes.clear();
+	m_leaves.clear();
+	m_heightfields.clear();
+	m_indices.clear();
+	m_centers.resize(numBodies);
+	m_radii.resize(numBodies);
+
+	for (int i = 0; i < numBodies; ++i) {
+		const Body& body = bodies[i];
+		if (ShapeHeightfield::SHAPE_HEIGHTFIELD == body.m_shape->GetType()) {
+			heightfield_t heightfield;
+			heightfield.bodyIndex = i;
+			heightfield.shape = static_cast<const ShapeHeightfield*>(body.m_shape);
+			heightfield.position = body.m_position;
+			heightfield.orientation = body.m_orientation;
+			heightfield.inverseOrientation = body.m_orientation.Inverse();
+			m_heightfields.push_back(heightfield);
+			continue;
+		}
+
+		m_indices.push_back(i);
+		if (Shape::SHAPE_SPHERE == body.m_shape->GetType()) {
+			m_centers[i] = body.m_position;
+			m_radii[i] = static_cast<const ShapeSphere*>(body.m_shape)->m_radius;
+		} else {
+			const Bounds bounds = body.m_shape->GetBounds(body.m_position, body.m_orientation);
+			m_centers[i] = (bounds.mins + bounds.maxs) * 0.5f;
+			m_radii[i] = (bounds.maxs - bounds.mins).GetMagnitude() * 0.5f;
+		}
+	}
+
+	const int numTreeBodies = static_cast<int>(m_indices.size());
+	if (0 == numTreeBodies)
+		return;
+
+	// a binary tree with leaves of four has less than numBodies / 2 nodes
+	m_nodes.reserve(numTreeBodies / 2 + 1);
+	m_leaves.reserve(numTreeBodies / 4 + 1);
+	BuildNode(0, numTreeBodies);
+}
+
+/*
+====================================================
+QueryTree::BuildNode
+====================================================
+*/
+int QueryTree::BuildNode(const int begin, const int end) {
+	const int nodeIndex = static_cast<int>(m_nodes.size());
+	m_nodes.push_back(node_t());
+
+	Bounds bounds;
+	Bounds centerBounds;
+	for (int i = begin; i < end; ++i) {
+		const Vec3& center = m_centers[m_indices[i]];
+		const float radius = m_radii[m_indices[i]];
+		bounds.Expand(center - Vec3(radius));
+		bounds.Expand(center + Vec3(radius));
+		centerBounds.Expand(center);
+	}
+	m_nodes[nodeIndex].bounds = bounds;
+
+	if (end - begin <= 4) {
+		leaf_t leaf;
+		leaf.count = end - begin;
+		for (int lane = 0; lane < 4; ++lane) {
+			// the tests mask out the lanes past count, they only need to hold valid numbers
+			const int bodyIndex = (lane < leaf.count) ? m_indices[begin + lane] : -1;
+			const Vec3 center = (bodyIndex >= 0) ? m_centers[bodyIndex] : Vec3(0.0f);
+			leaf.x[lane] = center.x;
+			leaf.y[lane] = center.y;
+			leaf.z[lane] = center.z;
+			leaf.radius[lane] = (bodyIndex >= 0) ? m_radii[bodyIndex] : 0.0f;
+			leaf.bodyIndex[lane] = bodyIndex;
+		}
+		m_nodes[nodeIndex].leaf = static_cast<int>(m_leaves.size());
+		m_nodes[nodeIndex].secondChild = -1;
+		m_nodes[nodeIndex].axis = 0;
+		m_leaves.push_back(leaf);
+		return nodeIndex;
+	}
+
+	// median split along the widest spread of the centers, keeps the depth at log2( n )
+	const Vec3 extents = centerBounds.maxs - centerBounds.mins;
+	int axis = 0;
+	if (extents.y > extents.x)
+		axis = 1;
+	if (extents.z > extents[axis])
+		axis = 2;
+
+	const int middle = (begin + end) / 2;
+	const std::vector<Vec3>& centers = m_centers;
+	std::nth_element(m_indices.begin() + begin, m_indices.begin() + middle, m_indices.begin() + end,
+		[&centers, axis](const int lhs, const int rhs) { return centers[lhs][axis] < centers[rhs][axis]; });
+
+	m_nodes[nodeIndex].leaf = -1;
+	m_nodes[nodeIndex].axis = axis;
+	BuildNode(begin, middle);
+	const int secondChild = BuildNode(middle, end);
+	m_nodes[nodeIndex].secondChild = secondChild;
+	return nodeIndex;
+}
+
+/*
+====================================================
+RayBounds
+// Slab test, returns the entry distance or a negative number on a miss
+====================================================
+*/
+static float RayBounds(const Bounds& bounds, const Vec3& start, const Vec3& invDirection, const float maxT) {
+	float tMin = 0.0f;
+	float tMax = maxT;
+	for (int axis = 0; axis < 3; ++axis) {
+		float t0 = (bounds.mins[axis] - start[axis]) * invDirection[axis];
+		float t1 = (bounds.maxs[axis] - start[axis]) * invDirection[axis];
+		if (t0 > t1)
+			std::swap(t0, t1);
+		tMin = (t0 > tMin) ? t0 : tMin;
+		tMax = (t1 < tMax) ? t1 : tMax;
+		if (tMin > tMax)
+			return -1.0f;
+	}
+	return tMin;
+}
+
+/*
+====================================================
+RayLeaf
+// Tests the ray against every sphere of a leaf at once. Returns a bit mask of
+// the lanes that were hit within [0, maxT], the times of those lanes are in times.
+====================================================
+*/
+static int RayLeaf(const float* x, const float* y, const float* z, const float* radius, const int count, const ray_t& ray, const float maxT, float* times) {
+#if PHYSICS_SIMD
+	const __m128 directionX = _mm_set1_ps(ray.direction.x);
+	const __m128 directionY = _mm_set1_ps(ray.direction.y);
+	const __m128 directionZ = _mm_set1_ps(ray.direction.z);
+	const __m128 toCenterX = _mm_sub_ps(_mm_load_ps(x), _mm_set1_ps(ray.start.x));
+	const __m128 toCenterY = _mm_sub_ps(_mm_load_ps(y), _mm_set1_ps(ray.start.y));
+	const __m128 toCenterZ = _mm_sub_ps(_mm_load_ps(z), _mm_set1_ps(ray.start.z));
+	const __m128 radii = _mm_load_ps(radius);
+
+	// same quadratic as RaySphere, four spheres at a time
+	const __m128 a = _mm_set1_ps(ray.direction.Dot(ray.direction));
+	const __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(toCenterX, directionX), _mm_mul_ps(toCenterY, directionY)), _mm_mul_ps(toCenterZ, directionZ));
+	const __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(toCenterX, toCenterX), _mm_mul_ps(toCenterY, toCenterY)), _mm_mul_ps(toCenterZ, toCenterZ)), _mm_mul_ps(radii, radii));
+	const __m128 discriminantSquared = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(a, c));
+	const __m128 discriminant = _mm_sqrt_ps(_mm_max_ps(discriminantSquared, _mm_setzero_ps()));
+	const __m128 invA = _mm_div_ps(_mm_set1_ps(1.0f), a);
+	const __m128 time1 = _mm_mul_ps(_mm_sub_ps(b, discriminant), invA);
+	const __m128 time2 = _mm_mul_ps(_mm_add_ps(b, discriminant), invA);
+	const __m128 time = _mm_max_ps(time1, _mm_setzero_ps());
+
+	__m128 isHit = _mm_cmpge_ps(discriminantSquared, _mm_setzero_ps());
+	isHit = _mm_and_ps(isHit, _mm_cmpge_ps(time2, _mm_setzero_ps()));
+	isHit = _mm_and_ps(isHit, _mm_cmple_ps(time, _mm_set1_ps(maxT)));
+	_mm_storeu_ps(times, time);
+	return _mm_movemask_ps(isHit) & ((1 << count) - 1);
+#else
+	int mask = 0;
+	for (int lane = 0; lane < count; ++lane) {
+		float time1;
+		float time2;
+		if (!RaySphere(ray.start, ray.direction, Vec3(x[lane], y[lane], z[lane]), radius[lane], time1, time2) || time2 < 0.0f)
+			continue;
+		times[lane] = (time1 < 0.0f) ? 0.0f : time1;
+		if (times[lane] <= maxT)
+			mask |= 1 << lane;
+	}
+	return mask;
+#endif
+}
+
+/*
+====================================================
+QueryTree::RayCast
+====================================================
+*/
+int QueryTree::RayCast(const ray_t& ray, const rayCastMode_t mode, rayHit_t* hits, const int maxHits) const {
+	if (maxHits <= 0)
+		return 0;
+
+	float maxT = ray.maxT;
+	int numHits = 0;
+
+	// the terrain first, a hit on it shortens the ray for the tree
+	for (int i = 0; i < m_heightfields.size(); ++i) {
+		const heightfield_t& heightfield = m_heightfields[i];
+		const Vec3 localStart = heightfield.inverseOrientation.RotatePoint(ray.start - heightfield.position);
+		const Vec3 localDirection = heightfield.inverseOrientation.RotatePoint(ray.direction);
+		float t;
+		Vec3 localNormal;
+		if (!heightfield.shape->RayCast(localStart, localDirection, maxT, t, localNormal))
+			continue;
+
+		rayHit_t* hit;
+		if (RAYCAST_ALL == mode) {
+			if (numHits >= maxHits)
+				return numHits;
+			hit = &hits[numHits++];
+		} else {
+			hit = &hits[0];
+			numHits = 1;
+			maxT = t;
+		}
+		hit->body = INVALID_BODY_HANDLE;
+		hit->bodyIndex = heightfield.bodyIndex;
+		hit->t = t;
+		hit->point = ray.start + ray.direction * t;
+		hit->normal = heightfield.orientation.RotatePoint(localNormal);
+
+		if (RAYCAST_ANY == mode)
+			return numHits;
+	}
+
+	if (m_nodes.empty())
+		return numHits;
+
+	const Vec3 invDirection(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+
+	int stack[MAX_DEPTH];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		const node_t& node = m_nodes[stack[--stackSize]];
+		if (RayBounds(node.bounds, ray.start, invDirection, maxT) < 0.0f)
+			continue;
+
+		if (node.leaf < 0) {
+			// visit the child on the side the ray comes from first, it usually holds the closest hit
+			const int firstChild = static_cast<int>(&node - m_nodes.data()) + 1;
+			if (ray.direction[node.axis] < 0.0f) {
+				stack[stackSize++] = firstChild;
+				stack[stackSize++] = node.secondChild;
+			} else {
+				stack[stackSize++] = node.secondChild;
+				stack[stackSize++] = firstChild;
+			}
+			continue;
+		}
+
+		const leaf_t& leaf = m_leaves[node.leaf];
+		float times[4];
+		int mask = RayLeaf(leaf.x, leaf.y, leaf.z, leaf.radius, leaf.count, ray, maxT, times);
+		for (int lane = 0; mask != 0; ++lane, mask >>= 1) {
+			if (0 == (mask & 1))
+				continue;
+
+			rayHit_t* hit;
+			if (RAYCAST_ALL == mode) {
+				if (numHits >= maxHits)
+					return numHits;
+				hit = &hits[numHits++];
+			} else {
+				// closest keeps shrinking the ray so farther hits and nodes get culled
+				if (numHits > 0 && times[lane] >= hits[0].t)
+					continue;
+				hit = &hits[0];
+				numHits = 1;
+				maxT = times[lane];
+			}
+
+			const Vec3 center(leaf.x[lane], leaf.y[lane], leaf.z[lane]);
+			hit->body = INVALID_BODY_HANDLE;
+			hit->bodyIndex = leaf.bodyIndex[lane];
+			hit->t = times[lane];
+			hit->point = ray.start + ray.direction * times[lane];
+			hit->normal = hit->point - center;
+			if (hit->normal.GetLengthSqr() > 0.0f) {
+				hit->normal.Normalize();
+			} else {
+				hit->normal = ray.direction * -1.0f;
+				hit->normal.Normalize();
+			}
+
+			if (RAYCAST_ANY == mode)
+				return numHits;
+		}
+	}
+	return numHits;
+}
+
+/*
+====================================================
+QueryTree::BoundsLeaf
+// Bit mask of the spheres of a leaf that touch the bounds
+====================================================
+*/
+int QueryTree::BoundsLeaf(const leaf_t& leaf, const Bounds& bounds) {
+#if PHYSICS_SIMD
+	// distance from each center to its closest point in the bounds
+	const __m128 x = _mm_load_ps(leaf.x);
+	const __m128 y = _mm_load_ps(leaf.y);
+	const __m128 z = _mm_load_ps(leaf.z);
+	const __m128 radius = _mm_load_ps(leaf.radius);
+	const __m128 deltaX = _mm_sub_ps(_mm_max_ps(_mm_min_ps(x, _mm_set1_ps(bounds.maxs.x)), _mm_set1_ps(bounds.mins.x)), x);
+	const __m128 deltaY = _mm_sub_ps(_mm_max_ps(_mm_min_ps(y, _mm_set1_ps(bounds.maxs.y)), _mm_set1_ps(bounds.mins.y)), y);
+	const __m128 deltaZ = _mm_sub_ps(_mm_max_ps(_mm_min_ps(z, _mm_set1_ps(bounds.maxs.z)), _mm_set1_ps(bounds.mins.z)), z);
+	const __m128 distanceSqr = _mm_add_ps(_mm_add_ps(_mm_mul_ps(deltaX, deltaX), _mm_mul_ps(deltaY, deltaY)), _mm_mul_ps(deltaZ, deltaZ));
+	const __m128 isInside = _mm_cmple_ps(distanceSqr, _mm_mul_ps(radius, radius));
+	return _mm_movemask_ps(isInside) & ((1 << leaf.count) - 1);
+#else
+	int mask = 0;
+	for (int lane = 0; lane < leaf.count; ++lane) {
+		const Vec3 center(leaf.x[lane], leaf.y[lane], leaf.z[lane]);
+		Vec3 closest = center;
+		for (int axis = 0; axis < 3; ++axis) {
+			closest[axis] = std::max(bounds.mins[axis], std::min(center[axis], bounds.maxs[axis]));
+		}
+		if ((closest - center).GetLengthSqr() <= leaf.radius[lane] * leaf.radius[lane])
+			mask |= 1 << lane;
+	}
+	return mask;
+#endif
+}
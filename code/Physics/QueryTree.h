@@ -0,0 +1,143 @@
+//
+//	QueryTree.h
+//
+#pragma once
+#include "Body.h"
+#include "BodyHandles.h"
+#include "Shapes/ShapeHeightfield.h"
+#include <vector>
+
+/*
+====================================================
+ray_t
+// Hits are at start + direction * t for t in [0, maxT]
+====================================================
+*/
+struct ray_t {
+	Vec3 start;
+	Vec3 direction;
+	float maxT;
+};
+
+/*
+====================================================
+rayHit_t
+====================================================
+*/
+struct rayHit_t {
+	bodyHandle_t body;
+	int bodyIndex;
+	Vec3 point;
+	Vec3 normal;
+	float t;	// 0 when the ray starts inside the body
+};
+
+/*
+====================================================
+QueryTree
+// Bounding volume hierarchy over the bodies of a scene for queries between
+// steps. Leaves hold up to four bodies as bounding spheres in SoA order, so
+// a leaf is tested in one go with SSE. Spheres are exact, other shapes are
+// tested against the sphere around their bounds. Heightfields are kept out of
+// the tree, the sphere around a terrain would cover the whole map, and are
+// tested exactly through their cells instead.
+====================================================
+*/
+class QueryTree {
+public:
+	enum rayCastMode_t {
+		RAYCAST_CLOSEST,
+		RAYCAST_ANY,
+		RAYCAST_ALL,
+	};
+
+	QueryTree() {}
+
+	void Build( const Body * bodies, const int numBodies );
+
+	// returns the number of hits written, RAYCAST_ALL writes them in no particular order
+	int RayCast( const ray_t & ray, const rayCastMode_t mode, rayHit_t * hits, const int maxHits ) const;
+
+	// Calls visitor( bodyIndex, center, radius ) for every body whose bounding sphere touches the bounds,
+	// until it returns false. Doesn't allocate, so any number of threads can run it at once.
+	// Only visits the bodies in the tree, the heightfields have to be tested on their own
+	template< typename Visitor >
+	void ForEachInBounds( const Bounds & bounds, Visitor & visitor ) const;
+
+	struct heightfield_t {
+		int bodyIndex;
+		const ShapeHeightfield * shape;
+		Vec3 position;
+		Quat orientation;
+		Quat inverseOrientation;	// takes world space into shape space
+	};
+	const std::vector< heightfield_t > & GetHeightfields() const { return m_heightfields; }
+
+private:
+	static const int MAX_DEPTH = 64;	// median splits keep the depth near log2( numBodies / 4 )
+
+	struct node_t {
+		Bounds bounds;
+		int secondChild;	// the first child follows its parent
+		int leaf;			// -1 for interior nodes
+		int axis;			// that the children were split along
+	};
+
+	struct alignas( 16 ) leaf_t {
+		float x[ 4 ];
+		float y[ 4 ];
+		float z[ 4 ];
+		float radius[ 4 ];
+		int bodyIndex[ 4 ];
+		int count;
+	};
+
+	int BuildNode( const int begin, const int end );
+	static int BoundsLeaf( const leaf_t & leaf, const Bounds & bounds );
+
+	std::vector< node_t > m_nodes;
+	std::vector< leaf_t > m_leaves;
+	std::vector< heightfield_t > m_heightfields;
+
+	// build scratch, kept around so rebuilding every step doesn't allocate
+	std::vector< int > m_indices;
+	std::vector< Vec3 > m_centers;
+	std::vector< float > m_radii;
+};
+
+/*
+====================================================
+QueryTree::ForEachInBounds
+====================================================
+*/
+template< typename Visitor >
+void QueryTree::ForEachInBounds( const Bounds & bounds, Visitor & visitor ) const {
+	if ( m_nodes.empty() ) {
+		return;
+	}
+
+	int stack[ MAX_DEPTH ];
+	int stackSize = 0;
+	stack[ stackSize++ ] = 0;
+	while ( stackSize > 0 ) {
+		const int nodeIndex = stack[ --stackSize ];
+		const node_t & node = m_nodes[ nodeIndex ];
+		if ( !node.bounds.DoesIntersect( bounds ) ) {
+			continue;
+		}
+
+		if ( node.leaf < 0 ) {
+			stack[ stackSize++ ] = node.secondChild;
+			stack[ stackSize++ ] = nodeIndex + 1;
+			continue;
+		}
+
+		const leaf_t & leaf = m_leaves[ node.leaf ];
+		int mask = BoundsLeaf( leaf, bounds );
+		for ( int lane = 0; mask != 0; ++lane, mask >>= 1 ) {
+			if ( ( mask & 1 ) && !visitor( leaf.bodyIndex[ lane ], Vec3( leaf.x[ lane ], leaf.y[ lane ], leaf.z[ lane ] ), leaf.radius[ lane ] ) ) {
+				return;
+			}
+		}
+	}
+}
@@ -0,0 +1,83 @@
+//
+//	SensorEvents.cpp
+//
+#include "SensorEvents.h"
+#include "Shapes/ShapeHeightfield.h"
+#include <algorithm>
+
+static uint64_t MakeKey(const bodyHandle_t handle) {
+	return (static_cast<uint64_t>(handle.slot) << 32) | handle.generation;
+}
+
+static bool IsLess(const sensorOverlap_t& lhs, const sensorOverlap_t& rhs) {
+	const uint64_t lhsSensor = MakeKey(lhs.sensor);
+	const uint64_t rhsSensor = MakeKey(rhs.sensor);
+	if (lhsSensor != rhsSensor)
+		return lhsSensor < rhsSensor;
+	return MakeKey(lhs.other) < MakeKey(rhs.other);
+}
+
+static void AddEvent(std::vector<sensorEvent_t>& events, const sensorOverlap_t& overlap, const sensorEventType_t type) {
+	sensorEvent_t event;
+	event.sensor = overlap.sensor;
+	event.other = overlap.other;
+	event.type = type;
+	event.step = 0;	// the scene stamps its events with the step
+	events.push_back(event);
+}
+
+/*
+====================================================
+SensorOverlap
+// Discrete test at the current positions, no time of impact
+====================================================
+*/
+bool SensorOverlap(const Body& sensor, const Body& other) {
+	if (Shape::SHAPE_SPHERE == sensor.m_shape->GetType() && Shape::SHAPE_SPHERE == other.m_shape->GetType()) {
+		const float radiusSum = static_cast<const ShapeSphere*>(sensor.m_shape)->m_radius + static_cast<const ShapeSphere*>(other.m_shape)->m_radius;
+		return (other.m_position - sensor.m_position).GetLengthSqr() <= radiusSum * radiusSum;
+	}
+
+	if (Shape::SHAPE_SPHERE == sensor.m_shape->GetType() && ShapeHeightfield::SHAPE_HEIGHTFIELD == other.m_shape->GetType()) {
+		const ShapeHeightfield* heightfield = static_cast<const ShapeHeightfield*>(other.m_shape);
+		const Vec3 localCenter = other.m_orientation.Inverse().RotatePoint(sensor.m_position - other.m_position);
+		Vec3 pointOnTerrain;
+		Vec3 normal;
+		float separation;
+		return heightfield->SphereContact(localCenter, static_cast<const ShapeSphere*>(sensor.m_shape)->m_radius, pointOnTerrain, normal, separation);
+	}
+
+	// the narrowphase only handles spheres so far, anything else overlaps by its bounds
+	const Bounds sensorBounds = sensor.m_shape->GetBounds(sensor.m_position, sensor.m_orientation);
+	const Bounds otherBounds = other.m_shape->GetBounds(other.m_position, other.m_orientation);
+	return sensorBounds.DoesIntersect(otherBounds);
+}
+
+/*
+====================================================
+SortSensorOverlaps
+====================================================
+*/
+void SortSensorOverlaps(std::vector<sensorOverlap_t>& overlaps) {
+	std::sort(overlaps.begin(), overlaps.end(), IsLess);
+}
+
+/*
+====================================================
+DiffSensorOverlaps
+====================================================
+*/
+void DiffSensorOverlaps(const std::vector<sensorOverlap_t>& previous, const std::vector<sensorOverlap_t>& current, std::vector<sensorEvent_t>& events) {
+	size_t previousIndex = 0;
+	size_t currentIndex = 0;
+	while (previousIndex < previous.size() || currentIndex < current.size()) {
+		if (currentIndex == current.size() || (previousIndex < previous.size() && IsLess(previous[previousIndex], current[currentIndex]))) {
+			AddEvent(events, previous[previousIndex++], SENSOR_EXIT);
+		} else if (previousIndex == previous.size() || IsLess(current[currentIndex], previous[previousIndex])) {
+			AddEvent(events, current[currentIndex++], SENSOR_ENTER);
+		} else {
+			AddEvent(events, current[currentIndex++], SENSOR_STAY);
+			previousIndex++;
+		}
+	}
+}
@@ -0,0 +1,42 @@
+//
+//	SensorEvents.h
+//
+#pragma once
+#include "Body.h"
+#include "BodyHandles.h"
+#include <vector>
+
+/*
+====================================================
+sensorEvent_t
+====================================================
+*/
+enum sensorEventType_t {
+	SENSOR_ENTER,
+	SENSOR_STAY,
+	SENSOR_EXIT,	// also sent when one of the bodies was removed, its handle is stale by then
+};
+
+struct sensorEvent_t {
+	bodyHandle_t sensor;
+	bodyHandle_t other;
+	sensorEventType_t type;
+	int64_t step;	// Scene::GetStepStats().step after the step that sent it
+};
+
+/*
+====================================================
+sensorOverlap_t
+// A sensor and a body that overlapped at the end of a step
+====================================================
+*/
+struct sensorOverlap_t {
+	bodyHandle_t sensor;
+	bodyHandle_t other;
+};
+
+bool SensorOverlap( const Body & sensor, const Body & other );
+
+// Both lists sorted with SortSensorOverlaps, appends an event for every overlap of either list
+void SortSensorOverlaps( std::vector< sensorOverlap_t > & overlaps );
+void DiffSensorOverlaps( const std::vector< sensorOverlap_t > & previous, const std::vector< sensorOverlap_t > & current, std::vector< sensorEvent_t > & events );
@@ -0,0 +1,60 @@
+//
+//	ShapeLibrary.cpp
+//
+#include "ShapeLibrary.h"
+#include <string.h>
+
+/*
+====================================================
+ShapeLibrary::MakeKey
+====================================================
+*/
+uint64_t ShapeLibrary::MakeKey(const Shape::shapeType_t type, const float parameter) {
+	uint32_t parameterBits;
+	memcpy(&parameterBits, &parameter, sizeof(parameterBits));
+	return (static_cast<uint64_t>(type) << 32) | parameterBits;
+}
+
+/*
+====================================================
+ShapeLibrary::AddSphere
+====================================================
+*/
+int ShapeLibrary::AddSphere(const float radius) {
+	const uint64_t key = MakeKey(Shape::SHAPE_SPHERE, radius);
+	std::unordered_map<uint64_t, int>::const_iterator it = m_shapeIndices.find(key);
+	if (it != m_shapeIndices.end())
+		return it->second;
+
+	const int shapeIndex = static_cast<int>(m_shapes.size());
+	m_shapes.push_back(m_spheres.Create(radius));
+	m_shapeIndices[key] = shapeIndex;
+	return shapeIndex;
+}
+
+/*
+====================================================
+ShapeLibrary::AddShape
+====================================================
+*/
+int ShapeLibrary::AddShape(Shape* shape) {
+	const int shapeIndex = static_cast<int>(m_shapes.size());
+	m_shapes.push_back(shape);
+	m_ownedShapes.push_back(shape);
+	return shapeIndex;
+}
+
+/*
+====================================================
+ShapeLibrary::Clear
+====================================================
+*/
+void ShapeLibrary::Clear() {
+	for (int i = 0; i < m_ownedShapes.size(); ++i)
+		delete m_ownedShapes[i];
+	m_ownedShapes.clear();
+
+	m_spheres.Clear();
+	m_shapes.clear();
+	m_shapeIndices.clear();
+}
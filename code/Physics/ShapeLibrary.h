@@ -0,0 +1,88 @@
+//
+//	ShapeLibrary.h
+//
+#pragma once
+#include "Shapes.h"
+#include <new>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+/*
+====================================================
+ShapePool
+// Block allocator for one shape type. Shapes never move once they are
+// created, and clearing the pool releases every block at once.
+====================================================
+*/
+template< typename T >
+class ShapePool {
+public:
+	ShapePool() : m_numInLastBlock( BLOCK_SIZE ) {}
+	~ShapePool() { Clear(); }
+
+	template< typename... Args >
+	T * Create( const Args &... args ) {
+		if ( m_numInLastBlock == BLOCK_SIZE ) {
+			m_blocks.push_back( static_cast< T * >( ::operator new( sizeof( T ) * BLOCK_SIZE ) ) );
+			m_numInLastBlock = 0;
+		}
+		T * shape = new ( m_blocks.back() + m_numInLastBlock ) T( args... );
+		++m_numInLastBlock;
+		return shape;
+	}
+
+	void Clear() {
+		for ( int blockIndex = 0; blockIndex < m_blocks.size(); ++blockIndex ) {
+			const int numShapes = ( blockIndex == m_blocks.size() - 1 ) ? m_numInLastBlock : BLOCK_SIZE;
+			for ( int i = 0; i < numShapes; ++i ) {
+				m_blocks[ blockIndex ][ i ].~T();
+			}
+			::operator delete( m_blocks[ blockIndex ] );
+		}
+		m_blocks.clear();
+		m_numInLastBlock = BLOCK_SIZE;
+	}
+
+private:
+	ShapePool( const ShapePool & );
+	ShapePool & operator = ( const ShapePool & );
+
+	static const int BLOCK_SIZE = 1024;
+
+	std::vector< T * > m_blocks;
+	int m_numInLastBlock;
+};
+
+/*
+====================================================
+ShapeLibrary
+// Owns every shape of a scene. Identical shapes are created only once and
+// bodies refer to them by index.
+====================================================
+*/
+class ShapeLibrary {
+public:
+	ShapeLibrary() {}
+	~ShapeLibrary() { Clear(); }
+
+	int AddSphere( const float radius );
+	int AddShape( Shape * shape );	// takes ownership of a shape that can't be shared
+
+	Shape * GetShape( const int shapeIndex ) const { return m_shapes[ shapeIndex ]; }
+	int GetNumShapes() const { return static_cast< int >( m_shapes.size() ); }
+
+	void Clear();
+
+private:
+	ShapeLibrary( const ShapeLibrary & );
+	ShapeLibrary & operator = ( const ShapeLibrary & );
+
+	static uint64_t MakeKey( const Shape::shapeType_t type, const float parameter );
+
+	std::vector< Shape * > m_shapes;			// shape index to shape
+	std::vector< Shape * > m_ownedShapes;		// shapes that weren't allocated from a pool
+	std::unordered_map< uint64_t, int > m_shapeIndices;	// shape type and parameters to shape index
+
+	ShapePool< ShapeSphere > m_spheres;
+};
@@ -0,0 +1,502 @@
+//
+//  ShapeHeightfield.cpp
+//
+#include "ShapeHeightfield.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+/*
+====================================================
+ClosestPointOnTriangle
+====================================================
+*/
+static Vec3 ClosestPointOnTriangle( const Vec3 & pt, const Vec3 & a, const Vec3 & b, const Vec3 & c ) {
+	const Vec3 ab = b - a;
+	const Vec3 ac = c - a;
+
+	const Vec3 ap = pt - a;
+	const float d1 = ab.Dot( ap );
+	const float d2 = ac.Dot( ap );
+	if ( d1 <= 0.0f && d2 <= 0.0f ) {
+		return a;
+	}
+
+	const Vec3 bp = pt - b;
+	const float d3 = ab.Dot( bp );
+	const float d4 = ac.Dot( bp );
+	if ( d3 >= 0.0f && d4 <= d3 ) {
+		return b;
+	}
+
+	const float vc = d1 * d4 - d3 * d2;
+	if ( vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f ) {
+		return a + ab * ( d1 / ( d1 - d3 ) );
+	}
+
+	const Vec3 cp = pt - c;
+	const float d5 = ab.Dot( cp );
+	const float d6 = ac.Dot( cp );
+	if ( d6 >= 0.0f && d5 <= d6 ) {
+		return c;
+	}
+
+	const float vb = d5 * d2 - d1 * d6;
+	if ( vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f ) {
+		return a + ac * ( d2 / ( d2 - d6 ) );
+	}
+
+	const float va = d3 * d6 - d5 * d4;
+	if ( va <= 0.0f && ( d4 - d3 ) >= 0.0f && ( d5 - d6 ) >= 0.0f ) {
+		return b + ( c - b ) * ( ( d4 - d3 ) / ( ( d4 - d3 ) + ( d5 - d6 ) ) );
+	}
+
+	const float invDenom = 1.0f / ( va + vb + vc );
+	return a + ab * ( vb * invDenom ) + ac * ( vc * invDenom );
+}
+
+/*
+====================================================
+IsOverTriangle
+// Whether the point is straight above or below the triangle, only x and y count
+====================================================
+*/
+static bool IsOverTriangle( const Vec3 & pt, const Vec3 & a, const Vec3 & b, const Vec3 & c ) {
+	const float d0 = ( b.x - a.x ) * ( pt.y - a.y ) - ( b.y - a.y ) * ( pt.x - a.x );
+	const float d1 = ( c.x - b.x ) * ( pt.y - b.y ) - ( c.y - b.y ) * ( pt.x - b.x );
+	const float d2 = ( a.x - c.x ) * ( pt.y - c.y ) - ( a.y - c.y ) * ( pt.x - c.x );
+	const bool hasNegative = ( d0 < 0.0f ) || ( d1 < 0.0f ) || ( d2 < 0.0f );
+	const bool hasPositive = ( d0 > 0.0f ) || ( d1 > 0.0f ) || ( d2 > 0.0f );
+	return !( hasNegative && hasPositive );
+}
+
+/*
+====================================================
+RayTriangle
+// Both sides of the triangle count, t can be negative
+====================================================
+*/
+static bool RayTriangle( const Vec3 & start, const Vec3 & direction, const Vec3 & a, const Vec3 & b, const Vec3 & c, float & t ) {
+	const Vec3 ab = b - a;
+	const Vec3 ac = c - a;
+	const Vec3 p = direction.Cross( ac );
+	const float det = ab.Dot( p );
+	if ( 0.0f == det ) {
+		return false;
+	}
+
+	const float invDet = 1.0f / det;
+	const Vec3 toStart = start - a;
+	const float u = toStart.Dot( p ) * invDet;
+	if ( u < 0.0f || u > 1.0f ) {
+		return false;
+	}
+	const Vec3 q = toStart.Cross( ab );
+	const float v = direction.Dot( q ) * invDet;
+	if ( v < 0.0f || u + v > 1.0f ) {
+		return false;
+	}
+	t = ac.Dot( q ) * invDet;
+	return true;
+}
+
+/*
+====================================================
+SphereTriangle
+// Keeps the contact if it's deeper than the one found so far. The distance is
+// the one to the closest point of the triangle, except for a center that sank
+// below the triangle right above it, which is pushed back up along the normal
+// so it comes out on top instead of falling through. The plane of a triangle
+// that isn't above the center says nothing about the sphere, a steep one next
+// to a plateau would make up a deep contact.
+====================================================
+*/
+static void SphereTriangle( const Vec3 & center, const float radius, const Vec3 & a, const Vec3 & b, const Vec3 & c,
+	bool & isFound, Vec3 & pointOnTerrain, Vec3 & normal, float & separation ) {
+	Vec3 faceNormal = ( b - a ).Cross( c - a );
+	faceNormal.Normalize();
+
+	const float height = ( center - a ).Dot( faceNormal );
+
+	float distance;
+	Vec3 direction;
+	if ( height < 0.0f && IsOverTriangle( center, a, b, c ) ) {
+		distance = height;
+		direction = faceNormal;
+	} else {
+		const Vec3 delta = center - ClosestPointOnTriangle( center, a, b, c );
+		distance = delta.GetMagnitude();
+		if ( distance - radius > 0.0f ) {
+			return;
+		}
+		direction = ( distance > 1.0e-6f ) ? delta / distance : faceNormal;
+	}
+
+	const float triangleSeparation = distance - radius;
+	if ( triangleSeparation > 0.0f || ( isFound && triangleSeparation >= separation ) ) {
+		return;
+	}
+	isFound = true;
+	pointOnTerrain = center - direction * distance;
+	normal = direction;
+	separation = triangleSeparation;
+}
+
+/*
+========================================================================================================
+
+ShapeHeightfield
+
+========================================================================================================
+*/
+
+/*
+====================================================
+ShapeHeightfield::ShapeHeightfield
+====================================================
+*/
+ShapeHeightfield::ShapeHeightfield( const int numSamplesX, const int numSamplesY, const float cellSize, const float * heights ) :
+m_numSamplesX( numSamplesX ),
+m_numSamplesY( numSamplesY ),
+m_cellSize( cellSize ),
+m_heights( heights, heights + numSamplesX * numSamplesY ) {
+	m_cellRanges.resize( ( numSamplesX - 1 ) * ( numSamplesY - 1 ) );
+	float minHeight = heights[ 0 ];
+	float maxHeight = heights[ 0 ];
+	for ( int y = 0; y < numSamplesY - 1; y++ ) {
+		for ( int x = 0; x < numSamplesX - 1; x++ ) {
+			const float h00 = GetHeight( x, y );
+			const float h10 = GetHeight( x + 1, y );
+			const float h01 = GetHeight( x, y + 1 );
+			const float h11 = GetHeight( x + 1, y + 1 );
+
+			cellRange_t & range = m_cellRanges[ y * ( numSamplesX - 1 ) + x ];
+			range.minHeight = std::min( std::min( h00, h10 ), std::min( h01, h11 ) );
+			range.maxHeight = std::max( std::max( h00, h10 ), std::max( h01, h11 ) );
+			minHeight = std::min( minHeight, range.minHeight );
+			maxHeight = std::max( maxHeight, range.maxHeight );
+		}
+	}
+
+	m_bounds.mins = Vec3( 0.0f, 0.0f, minHeight );
+	m_bounds.maxs = Vec3( float( numSamplesX - 1 ) * cellSize, float( numSamplesY - 1 ) * cellSize, maxHeight );
+	m_centerOfMass = ( m_bounds.mins + m_bounds.maxs ) * 0.5f;
+}
+
+/*
+====================================================
+ShapeHeightfield::Support
+// The terrain isn't convex, this is the support of its bounds
+====================================================
+*/
+Vec3 ShapeHeightfield::Support( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const {
+	const Quat inverseOrient = orient.Inverse();
+	const Vec3 localDir = inverseOrient.RotatePoint( dir );
+
+	Vec3 supportPt;
+	supportPt.x = ( localDir.x > 0.0f ) ? m_bounds.maxs.x : m_bounds.mins.x;
+	supportPt.y = ( localDir.y > 0.0f ) ? m_bounds.maxs.y : m_bounds.mins.y;
+	supportPt.z = ( localDir.z > 0.0f ) ? m_bounds.maxs.z : m_bounds.mins.z;
+
+	Vec3 norm = dir;
+	norm.Normalize();
+	return orient.RotatePoint( supportPt ) + pos + norm * bias;
+}
+
+/*
+====================================================
+ShapeHeightfield::InertiaTensor
+// Bodies invert the tensor even when they are static, so this is the one of
+// a solid box the size of the bounds
+====================================================
+*/
+Mat3 ShapeHeightfield::InertiaTensor() const {
+	const float dx = m_bounds.WidthX();
+	const float dy = m_bounds.WidthY();
+	const float dz = std::max( m_bounds.WidthZ(), m_cellSize );
+
+	Mat3 tensor;
+	tensor.Zero();
+	tensor.rows[0][0] = ( dy * dy + dz * dz ) / 12.0f;
+	tensor.rows[1][1] = ( dx * dx + dz * dz ) / 12.0f;
+	tensor.rows[2][2] = ( dx * dx + dy * dy ) / 12.0f;
+
+	return tensor;
+}
+
+/*
+====================================================
+ShapeHeightfield::GetBounds
+====================================================
+*/
+Bounds ShapeHeightfield::GetBounds( const Vec3 & pos, const Quat & orient ) const {
+	const Vec3 corners[ 8 ] = {
+		Vec3( m_bounds.mins.x, m_bounds.mins.y, m_bounds.mins.z ),
+		Vec3( m_bounds.maxs.x, m_bounds.mins.y, m_bounds.mins.z ),
+		Vec3( m_bounds.mins.x, m_bounds.maxs.y, m_bounds.mins.z ),
+		Vec3( m_bounds.maxs.x, m_bounds.maxs.y, m_bounds.mins.z ),
+		Vec3( m_bounds.mins.x, m_bounds.mins.y, m_bounds.maxs.z ),
+		Vec3( m_bounds.maxs.x, m_bounds.mins.y, m_bounds.maxs.z ),
+		Vec3( m_bounds.mins.x, m_bounds.maxs.y, m_bounds.maxs.z ),
+		Vec3( m_bounds.maxs.x, m_bounds.maxs.y, m_bounds.maxs.z ),
+	};
+
+	Bounds bounds;
+	for ( int i = 0; i < 8; i++ ) {
+		bounds.Expand( orient.RotatePoint( corners[ i ] ) + pos );
+	}
+	return bounds;
+}
+
+/*
+====================================================
+ShapeHeightfield::SphereContact
+// Only the cells under the footprint of the sphere are visited, a few for
+// spheres about the size of a cell no matter how large the terrain is
+====================================================
+*/
+bool ShapeHeightfield::SphereContact( const Vec3 & center, const float radius, Vec3 & pointOnTerrain, Vec3 & normal, float & separation ) const {
+	if ( center.x + radius < m_bounds.mins.x || center.x - radius > m_bounds.maxs.x ||
+		center.y + radius < m_bounds.mins.y || center.y - radius > m_bounds.maxs.y ||
+		center.z - radius > m_bounds.maxs.z ) {
+		return false;
+	}
+
+	const float invCellSize = 1.0f / m_cellSize;
+	const int minX = std::max( (int)floorf( ( center.x - radius ) * invCellSize ), 0 );
+	const int minY = std::max( (int)floorf( ( center.y - radius ) * invCellSize ), 0 );
+	const int maxX = std::min( (int)floorf( ( center.x + radius ) * invCellSize ), m_numSamplesX - 2 );
+	const int maxY = std::min( (int)floorf( ( center.y + radius ) * invCellSize ), m_numSamplesY - 2 );
+
+	bool isFound = false;
+	for ( int y = minY; y <= maxY; y++ ) {
+		for ( int x = minX; x <= maxX; x++ ) {
+			const cellRange_t & range = m_cellRanges[ y * ( m_numSamplesX - 1 ) + x ];
+			if ( center.z - radius > range.maxHeight ) {
+				continue;
+			}
+
+			const float x0 = float( x ) * m_cellSize;
+			const float y0 = float( y ) * m_cellSize;
+			const float x1 = x0 + m_cellSize;
+			const float y1 = y0 + m_cellSize;
+
+			// a flat cell right under the center is the plane of the cell, no need for its triangles
+			if ( range.minHeight == range.maxHeight && center.x >= x0 && center.x <= x1 && center.y >= y0 && center.y <= y1 ) {
+				const float cellSeparation = center.z - range.minHeight - radius;
+				if ( !isFound || cellSeparation < separation ) {
+					isFound = true;
+					pointOnTerrain = Vec3( center.x, center.y, range.minHeight );
+					normal = Vec3( 0.0f, 0.0f, 1.0f );
+					separation = cellSeparation;
+				}
+				continue;
+			}
+
+			const Vec3 p00( x0, y0, GetHeight( x, y ) );
+			const Vec3 p10( x1, y0, GetHeight( x + 1, y ) );
+			const Vec3 p01( x0, y1, GetHeight( x, y + 1 ) );
+			const Vec3 p11( x1, y1, GetHeight( x + 1, y + 1 ) );
+			SphereTriangle( center, radius, p00, p10, p01, isFound, pointOnTerrain, normal, separation );
+			SphereTriangle( center, radius, p11, p01, p10, isFound, pointOnTerrain, normal, separation );
+		}
+	}
+	return isFound;
+}
+
+/*
+====================================================
+ShapeHeightfield::SweepSphere
+====================================================
+*/
+bool ShapeHeightfield::SweepSphere( const Vec3 & center, const float radius, const Vec3 & displacement, const int maxSteps,
+	float & t, Vec3 & pointOnTerrain, Vec3 & normal, float & separation ) const {
+	t = 0.0f;
+	if ( SphereContact( center, radius, pointOnTerrain, normal, separation ) ) {
+		return true;
+	}
+
+	const int numSteps = std::min( (int)ceilf( displacement.GetMagnitude() / radius ), maxSteps );
+	float lastMiss = 0.0f;
+	for ( int step = 1; step <= numSteps; step++ ) {
+		float hit = float( step ) / float( numSteps );
+		if ( !SphereContact( center + displacement * hit, radius, pointOnTerrain, normal, separation ) ) {
+			lastMiss = hit;
+			continue;
+		}
+
+		const int numBisections = 4;
+		for ( int i = 0; i < numBisections; i++ ) {
+			const float middle = ( lastMiss + hit ) * 0.5f;
+			if ( SphereContact( center + displacement * middle, radius, pointOnTerrain, normal, separation ) ) {
+				hit = middle;
+			} else {
+				lastMiss = middle;
+			}
+		}
+		SphereContact( center + displacement * hit, radius, pointOnTerrain, normal, separation );
+		t = hit;
+		return true;
+	}
+	return false;
+}
+
+/*
+====================================================
+ShapeHeightfield::GetSurface
+====================================================
+*/
+bool ShapeHeightfield::GetSurface( const float x, const float y, float & height, Vec3 & normal ) const {
+	if ( x < m_bounds.mins.x || x > m_bounds.maxs.x || y < m_bounds.mins.y || y > m_bounds.maxs.y ) {
+		return false;
+	}
+
+	const float invCellSize = 1.0f / m_cellSize;
+	const int cellX = std::min( (int)( x * invCellSize ), m_numSamplesX - 2 );
+	const int cellY = std::min( (int)( y * invCellSize ), m_numSamplesY - 2 );
+	const float u = x * invCellSize - float( cellX );
+	const float v = y * invCellSize - float( cellY );
+
+	// same split as the collision and the render mesh, ( x0, y0 ) ( x1, y0 ) ( x0, y1 ) and ( x1, y1 ) ( x0, y1 ) ( x1, y0 )
+	float slopeX;
+	float slopeY;
+	if ( u + v <= 1.0f ) {
+		const float h00 = GetHeight( cellX, cellY );
+		slopeX = GetHeight( cellX + 1, cellY ) - h00;
+		slopeY = GetHeight( cellX, cellY + 1 ) - h00;
+		height = h00 + slopeX * u + slopeY * v;
+	} else {
+		const float h11 = GetHeight( cellX + 1, cellY + 1 );
+		slopeX = h11 - GetHeight( cellX, cellY + 1 );
+		slopeY = h11 - GetHeight( cellX + 1, cellY );
+		height = h11 - slopeX * ( 1.0f - u ) - slopeY * ( 1.0f - v );
+	}
+	normal = Vec3( -slopeX * invCellSize, -slopeY * invCellSize, 1.0f );
+	normal.Normalize();
+	return true;
+}
+
+/*
+====================================================
+ShapeHeightfield::RayCast
+// Steps from cell to cell along the ray (a 2D DDA), cells whose height range
+// the ray passes above or below are skipped without testing their triangles
+====================================================
+*/
+bool ShapeHeightfield::RayCast( const Vec3 & start, const Vec3 & direction, const float maxT, float & t, Vec3 & normal ) const {
+	float surfaceHeight;
+	if ( GetSurface( start.x, start.y, surfaceHeight, normal ) && start.z <= surfaceHeight ) {
+		t = 0.0f;
+		return true;
+	}
+
+	// clip the ray to the bounds
+	float tMin = 0.0f;
+	float tMax = maxT;
+	for ( int axis = 0; axis < 3; axis++ ) {
+		if ( 0.0f == direction[ axis ] ) {
+			if ( start[ axis ] < m_bounds.mins[ axis ] || start[ axis ] > m_bounds.maxs[ axis ] ) {
+				return false;
+			}
+			continue;
+		}
+		float t0 = ( m_bounds.mins[ axis ] - start[ axis ] ) / direction[ axis ];
+		float t1 = ( m_bounds.maxs[ axis ] - start[ axis ] ) / direction[ axis ];
+		if ( t0 > t1 ) {
+			std::swap( t0, t1 );
+		}
+		tMin = std::max( tMin, t0 );
+		tMax = std::min( tMax, t1 );
+		if ( tMin > tMax ) {
+			return false;
+		}
+	}
+
+	const float invCellSize = 1.0f / m_cellSize;
+	const Vec3 entry = start + direction * tMin;
+	int x = std::max( std::min( (int)floorf( entry.x * invCellSize ), m_numSamplesX - 2 ), 0 );
+	int y = std::max( std::min( (int)floorf( entry.y * invCellSize ), m_numSamplesY - 2 ), 0 );
+	const int stepX = ( direction.x > 0.0f ) ? 1 : -1;
+	const int stepY = ( direction.y > 0.0f ) ? 1 : -1;
+	const float deltaX = ( 0.0f != direction.x ) ? fabsf( m_cellSize / direction.x ) : FLT_MAX;
+	const float deltaY = ( 0.0f != direction.y ) ? fabsf( m_cellSize / direction.y ) : FLT_MAX;
+	float nextX = ( 0.0f != direction.x ) ? ( float( x + ( stepX > 0 ? 1 : 0 ) ) * m_cellSize - start.x ) / direction.x : FLT_MAX;
+	float nextY = ( 0.0f != direction.y ) ? ( float( y + ( stepY > 0 ? 1 : 0 ) ) * m_cellSize - start.y ) / direction.y : FLT_MAX;
+
+	float cellStart = tMin;
+	while ( true ) {
+		const float cellEnd = std::min( std::min( nextX, nextY ), tMax );
+		const float z0 = start.z + direction.z * cellStart;
+		const float z1 = start.z + direction.z * cellEnd;
+		const cellRange_t & range = m_cellRanges[ y * ( m_numSamplesX - 1 ) + x ];
+		if ( std::min( z0, z1 ) <= range.maxHeight && std::max( z0, z1 ) >= range.minHeight ) {
+			const float x0 = float( x ) * m_cellSize;
+			const float y0 = float( y ) * m_cellSize;
+			const Vec3 p00( x0, y0, GetHeight( x, y ) );
+			const Vec3 p10( x0 + m_cellSize, y0, GetHeight( x + 1, y ) );
+			const Vec3 p01( x0, y0 + m_cellSize, GetHeight( x, y + 1 ) );
+			const Vec3 p11( x0 + m_cellSize, y0 + m_cellSize, GetHeight( x + 1, y + 1 ) );
+
+			bool isHit = false;
+			float triangleT;
+			if ( RayTriangle( start, direction, p00, p10, p01, triangleT ) && triangleT >= 0.0f && triangleT <= maxT ) {
+				isHit = true;
+				t = triangleT;
+				normal = ( p10 - p00 ).Cross( p01 - p00 );
+			}
+			if ( RayTriangle( start, direction, p11, p01, p10, triangleT ) && triangleT >= 0.0f && triangleT <= maxT && ( !isHit || triangleT < t ) ) {
+				isHit = true;
+				t = triangleT;
+				normal = ( p01 - p11 ).Cross( p10 - p11 );
+			}
+			// the cells are visited in the order the ray crosses them, so the first hit is the closest
+			if ( isHit ) {
+				normal.Normalize();
+				return true;
+			}
+		}
+
+		if ( cellEnd >= tMax ) {
+			return false;
+		}
+		if ( nextX < nextY ) {
+			x += stepX;
+			cellStart = nextX;
+			nextX += deltaX;
+		} else {
+			y += stepY;
+			cellStart = nextY;
+			nextY += deltaY;
+		}
+		if ( x < 0 || x > m_numSamplesX - 2 || y < 0 || y > m_numSamplesY - 2 ) {
+			return false;
+		}
+	}
+}
+
+/*
+====================================================
+ShapeHeightfield::OverlapBounds
+====================================================
+*/
+bool ShapeHeightfield::OverlapBounds( const Bounds & bounds ) const {
+	if ( bounds.maxs.x < m_bounds.mins.x || bounds.mins.x > m_bounds.maxs.x ||
+		bounds.maxs.y < m_bounds.mins.y || bounds.mins.y > m_bounds.maxs.y ||
+		bounds.mins.z > m_bounds.maxs.z ) {
+		return false;
+	}
+
+	const float invCellSize = 1.0f / m_cellSize;
+	const int minX = std::max( (int)floorf( bounds.mins.x * invCellSize ), 0 );
+	const int minY = std::max( (int)floorf( bounds.mins.y * invCellSize ), 0 );
+	const int maxX = std::min( (int)floorf( bounds.maxs.x * invCellSize ), m_numSamplesX - 2 );
+	const int maxY = std::min( (int)floorf( bounds.maxs.y * invCellSize ), m_numSamplesY - 2 );
+	for ( int y = minY; y <= maxY; y++ ) {
+		for ( int x = minX; x <= maxX; x++ ) {
+			if ( bounds.mins.z <= m_cellRanges[ y * ( m_numSamplesX - 1 ) + x ].maxHeight ) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
@@ -0,0 +1,58 @@
+//
+//  ShapeHeightfield.h
+//
+#pragma once
+#include "../ShapeBase.h"
+#include <vector>
+
+/*
+====================================================
+ShapeHeightfield
+// Terrain as a grid of heights along z. Sample (x,y) sits at (x,y) * cellSize
+// in shape space, so the first sample is the corner of the grid. Every cell
+// keeps the lowest and highest of its four corners, tests reject a cell by
+// those before looking at its two triangles. Only for static bodies.
+====================================================
+*/
+class ShapeHeightfield : public Shape {
+public:
+	// the shape types of ShapeBase.h end with the convex hull, the heightfield takes the next one
+	static constexpr shapeType_t SHAPE_HEIGHTFIELD = shapeType_t( SHAPE_CONVEX + 1 );
+
+	// heights holds numSamplesX * numSamplesY samples, one row along x after the other, at least 2x2
+	ShapeHeightfield( const int numSamplesX, const int numSamplesY, const float cellSize, const float * heights );
+
+	Vec3 Support( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const override;
+	Mat3 InertiaTensor() const override;
+	Bounds GetBounds( const Vec3 & pos, const Quat & orient ) const override;
+	Bounds GetBounds() const override { return m_bounds; }
+	shapeType_t GetType() const override { return SHAPE_HEIGHTFIELD; }
+
+	float GetHeight( const int x, const int y ) const { return m_heights[ y * m_numSamplesX + x ]; }
+
+	// Deepest contact of a sphere with the cells under its footprint, all in shape space. The normal points
+	// from the terrain to the sphere, the separation is negative when they overlap and a touch counts too.
+	bool SphereContact( const Vec3 & center, const float radius, Vec3 & pointOnTerrain, Vec3 & normal, float & separation ) const;
+	// First contact of a sphere moved by displacement, t is the fraction of the displacement. The motion is
+	// marched in steps of at most the radius, at most maxSteps of them, and the first hit is bisected.
+	bool SweepSphere( const Vec3 & center, const float radius, const Vec3 & displacement, const int maxSteps,
+		float & t, Vec3 & pointOnTerrain, Vec3 & normal, float & separation ) const;
+	// Walks the cells under the ray in order, hits are at start + direction * t. A ray starting below the surface hits at t = 0.
+	bool RayCast( const Vec3 & start, const Vec3 & direction, const float maxT, float & t, Vec3 & normal ) const;
+	// Whether the bounds reach below the highest corner of any cell under them, everything under the surface counts as solid
+	bool OverlapBounds( const Bounds & bounds ) const;
+	// Height and normal of the surface straight above or below x,y, false outside the grid
+	bool GetSurface( const float x, const float y, float & height, Vec3 & normal ) const;
+
+	struct cellRange_t {
+		float minHeight;
+		float maxHeight;
+	};
+
+	int m_numSamplesX;
+	int m_numSamplesY;
+	float m_cellSize;
+	std::vector< float > m_heights;
+	std::vector< cellRange_t > m_cellRanges;	// ( m_numSamplesX - 1 ) * ( m_numSamplesY - 1 ) cells
+	Bounds m_bounds;
+};
@@ -0,0 +1,344 @@
+//
+//  Profiler.cpp
+//
+#include "Profiler.h"
+#include <atomic>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#if PHYSICS_PROFILER
+
+/*
+====================================================
+eventRing_t
+// Single producer (the owning thread), single consumer (Collect)
+====================================================
+*/
+struct eventRing_t {
+	static const int CAPACITY = 8192;
+
+	profileEvent_t events[ CAPACITY ];
+	std::atomic< int64_t > writeIndex;
+	std::atomic< int64_t > readIndex;
+	std::atomic< int64_t > numDropped;
+	std::atomic< bool > isRetired;	// the thread exited, the ring goes away once it's drained
+	int threadId;
+	char threadName[ 32 ];	// written and read under g_profilerMutex
+};
+
+/*
+====================================================
+eventRingOwner_t
+// Retires the ring of a thread when the thread exits
+====================================================
+*/
+struct eventRingOwner_t {
+	eventRingOwner_t() : ring( NULL ) {}
+	~eventRingOwner_t() {
+		if ( NULL != ring ) {
+			ring->isRetired.store( true, std::memory_order_release );
+		}
+	}
+
+	eventRing_t * ring;
+};
+
+/*
+====================================================
+zoneHistogram_t
+// 8 buckets per power of two, values below 16 get a bucket each
+====================================================
+*/
+struct zoneHistogram_t {
+	static const int NUM_BUCKETS = 16 + 60 * 8;
+
+	static int GetBucket( const int64_t value ) {
+		if ( value < 16 ) {
+			return ( value < 0 ) ? 0 : static_cast< int >( value );
+		}
+		int exponent = 63;
+		while ( 0 == ( value >> exponent ) ) {
+			exponent--;
+		}
+		const int subBucket = static_cast< int >( ( value >> ( exponent - 3 ) ) & 7 );
+		return 16 + ( exponent - 4 ) * 8 + subBucket;
+	}
+
+	static int64_t GetBucketUpperBound( const int bucket ) {
+		if ( bucket < 16 ) {
+			return bucket;
+		}
+		const int exponent = ( bucket - 16 ) / 8 + 4;
+		const int subBucket = ( bucket - 16 ) % 8;
+		return ( static_cast< int64_t >( 8 + subBucket + 1 ) << ( exponent - 3 ) ) - 1;
+	}
+
+	uint32_t buckets[ NUM_BUCKETS ];
+};
+
+struct zone_t {
+	const char * name;
+	int64_t count;
+	int64_t min;
+	int64_t max;
+	int64_t sum;
+	zoneHistogram_t histogram;
+};
+
+static std::mutex g_profilerMutex;
+static std::vector< zone_t * > g_zones;
+static std::vector< eventRing_t * > g_eventRings;
+static Profiler::eventListener_t g_eventListener = NULL;
+static void * g_eventListenerUserData = NULL;
+static int64_t g_numDroppedEvents = 0;
+
+static std::atomic< int > g_nextThreadId( 0 );
+
+static thread_local eventRingOwner_t t_eventRing;
+
+static void ClearZone( zone_t & zone ) {
+	zone.count = 0;
+	zone.min = 0;
+	zone.max = 0;
+	zone.sum = 0;
+	memset( zone.histogram.buckets, 0, sizeof( zone.histogram.buckets ) );
+}
+
+/*
+====================================================
+Profiler::RegisterZone
+====================================================
+*/
+int Profiler::RegisterZone( const char * name ) {
+	std::lock_guard< std::mutex > lock( g_profilerMutex );
+	for ( int i = 0; i < g_zones.size(); i++ ) {
+		if ( 0 == strcmp( g_zones[ i ]->name, name ) ) {
+			return i;
+		}
+	}
+
+	zone_t * zone = new zone_t;
+	zone->name = name;
+	ClearZone( *zone );
+	g_zones.push_back( zone );
+	return static_cast< int >( g_zones.size() ) - 1;
+}
+
+/*
+====================================================
+GetThreadRing
+====================================================
+*/
+static eventRing_t * GetThreadRing() {
+	eventRing_t * ring = t_eventRing.ring;
+	if ( NULL == ring ) {
+		// first use on this thread, the ring lives until the thread exits and Collect drained it
+		ring = new eventRing_t;
+		ring->writeIndex = 0;
+		ring->readIndex = 0;
+		ring->numDropped = 0;
+		ring->isRetired = false;
+		ring->threadId = g_nextThreadId.fetch_add( 1, std::memory_order_relaxed );
+		snprintf( ring->threadName, sizeof( ring->threadName ), "Thread %d", ring->threadId );
+
+		std::lock_guard< std::mutex > lock( g_profilerMutex );
+		g_eventRings.push_back( ring );
+		t_eventRing.ring = ring;
+	}
+	return ring;
+}
+
+/*
+====================================================
+Profiler::SetThreadName
+====================================================
+*/
+void Profiler::SetThreadName( const char * name ) {
+	eventRing_t * ring = GetThreadRing();
+
+	std::lock_guard< std::mutex > lock( g_profilerMutex );
+	snprintf( ring->threadName, sizeof( ring->threadName ), "%s", name );
+}
+
+/*
+====================================================
+Profiler::Record
+====================================================
+*/
+void Profiler::Record( const int zoneIndex, const int64_t startTime, const int64_t endTime ) {
+	eventRing_t * ring = GetThreadRing();
+
+	const int64_t writeIndex = ring->writeIndex.load( std::memory_order_relaxed );
+	if ( writeIndex - ring->readIndex.load( std::memory_order_acquire ) >= eventRing_t::CAPACITY ) {
+		ring->numDropped.fetch_add( 1, std::memory_order_relaxed );
+		return;
+	}
+
+	profileEvent_t & event = ring->events[ writeIndex % eventRing_t::CAPACITY ];
+	event.zoneIndex = zoneIndex;
+	event.threadId = ring->threadId;
+	event.startTime = startTime;
+	event.endTime = endTime;
+	ring->writeIndex.store( writeIndex + 1, std::memory_order_release );
+}
+
+/*
+====================================================
+Profiler::Collect
+====================================================
+*/
+void Profiler::Collect() {
+	std::lock_guard< std::mutex > lock( g_profilerMutex );
+
+	for ( int ringIndex = 0; ringIndex < g_eventRings.size(); ringIndex++ ) {
+		eventRing_t & ring = *g_eventRings[ ringIndex ];
+		// before the write index, so the last events of a retired ring are seen
+		const bool isRetired = ring.isRetired.load( std::memory_order_acquire );
+		const int64_t writeIndex = ring.writeIndex.load( std::memory_order_acquire );
+		int64_t readIndex = ring.readIndex.load( std::memory_order_relaxed );
+
+		for ( ; readIndex < writeIndex; readIndex++ ) {
+			const profileEvent_t & event = ring.events[ readIndex % eventRing_t::CAPACITY ];
+			zone_t & zone = *g_zones[ event.zoneIndex ];
+			if ( NULL != g_eventListener ) {
+				g_eventListener( event, zone.name, ring.threadName, g_eventListenerUserData );
+			}
+
+			const int64_t duration = event.endTime - event.startTime;
+			if ( 0 == zone.count || duration < zone.min ) {
+				zone.min = duration;
+			}
+			if ( 0 == zone.count || duration > zone.max ) {
+				zone.max = duration;
+			}
+			zone.sum += duration;
+			zone.count++;
+			zone.histogram.buckets[ zoneHistogram_t::GetBucket( duration ) ]++;
+		}
+		ring.readIndex.store( readIndex, std::memory_order_release );
+
+		g_numDroppedEvents += ring.numDropped.exchange( 0, std::memory_order_relaxed );
+
+		if ( isRetired ) {
+			delete &ring;
+			g_eventRings[ ringIndex ] = g_eventRings.back();
+			g_eventRings.pop_back();
+			ringIndex--;
+		}
+	}
+}
+
+/*
+====================================================
+Profiler::Reset
+====================================================
+*/
+void Profiler::Reset() {
+	Collect();
+
+	std::lock_guard< std::mutex > lock( g_profilerMutex );
+	for ( int i = 0; i < g_zones.size(); i++ ) {
+		ClearZone( *g_zones[ i ] );
+	}
+	g_numDroppedEvents = 0;
+}
+
+/*
+====================================================
+Profiler::GetNumZones
+====================================================
+*/
+int Profiler::GetNumZones() {
+	std::lock_guard< std::mutex > lock( g_profilerMutex );
+	return static_cast< int >( g_zones.size() );
+}
+
+/*
+====================================================
+Profiler::GetZoneStats
+====================================================
+*/
+bool Profiler::GetZoneStats( const int zoneIndex, zoneStats_t & stats ) {
+	Collect();
+
+	std::lock_guard< std::mutex > lock( g_profilerMutex );
+	if ( zoneIndex < 0 || zoneIndex >= g_zones.size() ) {
+		return false;
+	}
+
+	const zone_t & zone = *g_zones[ zoneIndex ];
+	stats.name = zone.name;
+	stats.count = zone.count;
+	stats.min = zone.min;
+	stats.max = zone.max;
+	stats.avg = ( zone.count > 0 ) ? double( zone.sum ) / double( zone.count ) : 0.0;
+	stats.p99 = 0;
+
+	// walk the histogram until 99% of the samples are covered
+	const int64_t target = zone.count - zone.count / 100;
+	int64_t numCovered = 0;
+	for ( int bucket = 0; bucket < zoneHistogram_t::NUM_BUCKETS && zone.count > 0; bucket++ ) {
+		numCovered += zone.histogram.buckets[ bucket ];
+		if ( numCovered >= target ) {
+			stats.p99 = zoneHistogram_t::GetBucketUpperBound( bucket );
+			break;
+		}
+	}
+	if ( stats.p99 > stats.max ) {
+		stats.p99 = stats.max;
+	}
+	return true;
+}
+
+bool Profiler::GetZoneStats( const char * name, zoneStats_t & stats ) {
+	int zoneIndex = -1;
+	{
+		std::lock_guard< std::mutex > lock( g_profilerMutex );
+		for ( int i = 0; i < g_zones.size(); i++ ) {
+			if ( 0 == strcmp( g_zones[ i ]->name, name ) ) {
+				zoneIndex = i;
+			}
+		}
+	}
+	return GetZoneStats( zoneIndex, stats );
+}
+
+/*
+====================================================
+Profiler::GetNumDroppedEvents
+====================================================
+*/
+int64_t Profiler::GetNumDroppedEvents() {
+	Collect();
+
+	std::lock_guard< std::mutex > lock( g_profilerMutex );
+	return g_numDroppedEvents;
+}
+
+/*
+====================================================
+Profiler::SetEventListener
+====================================================
+*/
+void Profiler::SetEventListener( eventListener_t listener, void * userData ) {
+	std::lock_guard< std::mutex > lock( g_profilerMutex );
+	g_eventListener = listener;
+	g_eventListenerUserData = userData;
+}
+
+#else
+
+int Profiler::RegisterZone( const char * name ) { return 0; }
+void Profiler::Record( const int zoneIndex, const int64_t startTime, const int64_t endTime ) {}
+void Profiler::SetThreadName( const char * name ) {}
+void Profiler::Collect() {}
+void Profiler::Reset() {}
+int Profiler::GetNumZones() { return 0; }
+bool Profiler::GetZoneStats( const int zoneIndex, zoneStats_t & stats ) { return false; }
+bool Profiler::GetZoneStats( const char * name, zoneStats_t & stats ) { return false; }
+int64_t Profiler::GetNumDroppedEvents() { return 0; }
+void Profiler::SetEventListener( eventListener_t listener, void * userData ) {}
+
+#endif
@@ -0,0 +1,98 @@
+//
+//  Profiler.h
+//
+#pragma once
+#include <stdint.h>
+
+// Set to 0 to compile every PROFILE_SCOPE out
+#ifndef PHYSICS_PROFILER
+#define PHYSICS_PROFILER 1
+#endif
+
+/*
+====================================================
+zoneStats_t
+// Aggregated over every sample since the last Profiler::Reset, in nanoseconds
+====================================================
+*/
+struct zoneStats_t {
+	const char * name;
+	int64_t count;
+	int64_t min;
+	int64_t max;
+	double avg;
+	int64_t p99;	// upper bound of the histogram bucket, within 12.5% of the exact value
+};
+
+/*
+====================================================
+profileEvent_t
+====================================================
+*/
+struct profileEvent_t {
+	int zoneIndex;
+	int threadId;	// unique for the life of the process, ids of threads that exited aren't reused
+	int64_t startTime;
+	int64_t endTime;
+};
+
+/*
+====================================================
+Profiler
+// Zones write their events into a lock-free ring buffer owned by the
+// thread they ran on. Collect drains the rings into the per zone stats,
+// every query collects first, and frees the rings of threads that exited.
+====================================================
+*/
+class Profiler {
+public:
+	static int RegisterZone( const char * name );
+	static void Record( const int zoneIndex, const int64_t startTime, const int64_t endTime );
+	static void SetThreadName( const char * name );	// of the calling thread, for traces. Unnamed threads are "Thread <id>"
+
+	static void Collect();
+	static void Reset();
+
+	static int GetNumZones();
+	static bool GetZoneStats( const int zoneIndex, zoneStats_t & stats );
+	static bool GetZoneStats( const char * name, zoneStats_t & stats );
+	static int64_t GetNumDroppedEvents();
+
+	// Called from Collect with every event, before it goes into the stats
+	typedef void ( *eventListener_t )( const profileEvent_t & event, const char * zoneName, const char * threadName, void * userData );
+	static void SetEventListener( eventListener_t listener, void * userData );
+};
+
+#if PHYSICS_PROFILER
+
+#include "../Clock.h"
+
+/*
+====================================================
+ScopedZone
+====================================================
+*/
+class ScopedZone {
+public:
+	explicit ScopedZone( const int zoneIndex ) : m_zoneIndex( zoneIndex ), m_startTime( GetTimeNanoseconds() ) {}
+	~ScopedZone() { Profiler::Record( m_zoneIndex, m_startTime, GetTimeNanoseconds() ); }
+
+private:
+	ScopedZone( const ScopedZone & );
+	ScopedZone & operator = ( const ScopedZone & );
+
+	int m_zoneIndex;
+	int64_t m_startTime;
+};
+
+#define PROFILE_CONCAT_INNER( a, b ) a##b
+#define PROFILE_CONCAT( a, b ) PROFILE_CONCAT_INNER( a, b )
+#define PROFILE_SCOPE( name ) \
+	static const int PROFILE_CONCAT( profileZoneIndex, __LINE__ ) = Profiler::RegisterZone( name ); \
+	ScopedZone PROFILE_CONCAT( profileZone, __LINE__ )( PROFILE_CONCAT( profileZoneIndex, __LINE__ ) )
+
+#else
+
+#define PROFILE_SCOPE( name )
+
+#endif
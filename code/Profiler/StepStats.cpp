@@ -0,0 +1,60 @@
+//
+//  StepStats.cpp
+//
+#include "StepStats.h"
+
+/*
+====================================================
+StepStatsWriter::Open
+====================================================
+*/
+bool StepStatsWriter::Open( const char * fileName, const format_t format ) {
+	Close();
+
+	m_file = fopen( fileName, "wb" );
+	if ( NULL == m_file ) {
+		return false;
+	}
+
+	m_format = format;
+	if ( FORMAT_CSV == m_format ) {
+		fprintf( m_file, "step,bodies,awake_bodies,pairs,contacts,pair_efficiency,toi_events,max_penetration,scratch_bytes,narrowphase_ms,reorder_ms,degradations\n" );
+	}
+	return true;
+}
+
+/*
+====================================================
+StepStatsWriter::Close
+====================================================
+*/
+void StepStatsWriter::Close() {
+	if ( NULL != m_file ) {
+		fclose( m_file );
+		m_file = NULL;
+	}
+}
+
+/*
+====================================================
+StepStatsWriter::Write
+====================================================
+*/
+void StepStatsWriter::Write( const stepStats_t & stats ) {
+	if ( NULL == m_file ) {
+		return;
+	}
+
+	// stdio buffers the lines, nothing is flushed per step
+	if ( FORMAT_CSV == m_format ) {
+		fprintf( m_file, "%lld,%d,%d,%d,%d,%.4f,%d,%.6f,%lld,%.4f,%.4f,%d\n",
+			(long long)stats.step, stats.numBodies, stats.numAwakeBodies, stats.numCollisionPairs, stats.numContacts,
+			stats.pairEfficiency, stats.numToiEvents, stats.maxPenetration, (long long)stats.scratchBytesUsed,
+			stats.narrowPhaseMilliseconds, stats.reorderMilliseconds, stats.degradations );
+	} else {
+		fprintf( m_file, "{\"step\":%lld,\"bodies\":%d,\"awake_bodies\":%d,\"pairs\":%d,\"contacts\":%d,\"pair_efficiency\":%.4f,\"toi_events\":%d,\"max_penetration\":%.6f,\"scratch_bytes\":%lld,\"narrowphase_ms\":%.4f,\"reorder_ms\":%.4f,\"degradations\":%d}\n",
+			(long long)stats.step, stats.numBodies, stats.numAwakeBodies, stats.numCollisionPairs, stats.numContacts,
+			stats.pairEfficiency, stats.numToiEvents, stats.maxPenetration, (long long)stats.scratchBytesUsed,
+			stats.narrowPhaseMilliseconds, stats.reorderMilliseconds, stats.degradations );
+	}
+}
@@ -0,0 +1,57 @@
+//
+//  StepStats.h
+//
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+====================================================
+stepStats_t
+// Counters of a single Scene::Update
+====================================================
+*/
+struct stepStats_t {
+	int64_t step;
+	int numBodies;
+	int numAwakeBodies;			// dynamic bodies that moved during the step
+	int numCollisionPairs;		// pairs out of the broadphase
+	int numContacts;			// pairs the narrowphase turned into contacts
+	float pairEfficiency;		// contacts per pair, 1 would be a perfect broadphase
+	int numToiEvents;			// contacts in the future of the step, rather than already touching
+	float maxPenetration;		// deepest overlap among the contacts
+	int64_t scratchBytesUsed;	// per step scratch memory the step actually used
+	float narrowPhaseMilliseconds;
+	float reorderMilliseconds;	// sorting the bodies by Morton code before the step, 0 on steps without a reorder
+	int degradations;			// Scene::degradation_t bits the step ran with
+};
+
+/*
+====================================================
+StepStatsWriter
+// Streams the stats of every step to a CSV or JSON lines file
+====================================================
+*/
+class StepStatsWriter {
+public:
+	enum format_t {
+		FORMAT_CSV,
+		FORMAT_JSONL,
+	};
+
+	StepStatsWriter() : m_file( NULL ), m_format( FORMAT_CSV ) {}
+	~StepStatsWriter() { Close(); }
+
+	bool Open( const char * fileName, const format_t format );
+	void Close();
+	bool IsOpen() const { return NULL != m_file; }
+
+	void Write( const stepStats_t & stats );
+
+private:
+	StepStatsWriter( const StepStatsWriter & );
+	StepStatsWriter & operator = ( const StepStatsWriter & );
+
+	FILE * m_file;
+	format_t m_format;
+};
@@ -0,0 +1,167 @@
+//
+//  TraceRecorder.cpp
+//
+#include "TraceRecorder.h"
+#include "../Clock.h"
+#include <string.h>
+
+/*
+====================================================
+TraceRecorder::TraceRecorder
+====================================================
+*/
+TraceRecorder::TraceRecorder() :
+	m_file( NULL ),
+	m_buffer( NULL ),
+	m_bufferUsed( 0 ),
+	m_startTime( 0 ),
+	m_isFirstEvent( true ) {
+}
+
+/*
+====================================================
+TraceRecorder::~TraceRecorder
+====================================================
+*/
+TraceRecorder::~TraceRecorder() {
+	End();
+}
+
+/*
+====================================================
+TraceRecorder::Begin
+====================================================
+*/
+bool TraceRecorder::Begin( const char * fileName ) {
+	End();
+
+	m_file = fopen( fileName, "wb" );
+	if ( NULL == m_file ) {
+		return false;
+	}
+	m_buffer = new char[ BUFFER_SIZE ];
+	m_bufferUsed = 0;
+	m_isFirstEvent = true;
+	m_isThreadNamed.clear();
+
+	// events from before the capture go to the stats only
+	Profiler::Collect();
+	m_startTime = GetTimeNanoseconds();
+	Profiler::SetEventListener( OnEvent, this );
+
+	const char * header = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	Write( header, (int)strlen( header ) );
+	return true;
+}
+
+/*
+====================================================
+TraceRecorder::End
+====================================================
+*/
+void TraceRecorder::End() {
+	if ( NULL == m_file ) {
+		return;
+	}
+
+	Profiler::Collect();
+	Profiler::SetEventListener( NULL, NULL );
+
+	const char * footer = "\n]}\n";
+	Write( footer, (int)strlen( footer ) );
+	Flush();
+
+	fclose( m_file );
+	m_file = NULL;
+	delete[] m_buffer;
+	m_buffer = NULL;
+}
+
+/*
+====================================================
+TraceRecorder::OnEvent
+====================================================
+*/
+void TraceRecorder::OnEvent( const profileEvent_t & event, const char * zoneName, const char * threadName, void * userData ) {
+	TraceRecorder * recorder = reinterpret_cast< TraceRecorder * >( userData );
+	recorder->WriteEvent( event, zoneName, threadName );
+}
+
+/*
+====================================================
+CopyJsonString
+// Zone and thread names come from the code, anything that would need escaping is dropped
+====================================================
+*/
+static void CopyJsonString( char * dest, const int destSize, const char * src ) {
+	int length = 0;
+	for ( const char * c = src; *c != '\0' && length < destSize - 1; c++ ) {
+		if ( *c != '"' && *c != '\\' && (unsigned char)*c >= 0x20 ) {
+			dest[ length++ ] = *c;
+		}
+	}
+	dest[ length ] = '\0';
+}
+
+/*
+====================================================
+TraceRecorder::WriteEvent
+====================================================
+*/
+void TraceRecorder::WriteEvent( const profileEvent_t & event, const char * zoneName, const char * threadName ) {
+	if ( event.startTime < m_startTime ) {
+		return;
+	}
+
+	char text[ 512 ];
+	int length = 0;
+
+	// name each thread the first time it shows up, the tid is the profiler's process wide thread id
+	if ( event.threadId >= m_isThreadNamed.size() ) {
+		m_isThreadNamed.resize( event.threadId + 1, false );
+	}
+	if ( !m_isThreadNamed[ event.threadId ] ) {
+		m_isThreadNamed[ event.threadId ] = true;
+		char thread[ 64 ];
+		CopyJsonString( thread, sizeof( thread ), threadName );
+		length = snprintf( text, sizeof( text ), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+			m_isFirstEvent ? "" : ",\n", event.threadId, thread );
+		Write( text, length );
+		m_isFirstEvent = false;
+	}
+
+	char name[ 128 ];
+	CopyJsonString( name, sizeof( name ), zoneName );
+
+	// complete events, timestamps are in microseconds
+	length = snprintf( text, sizeof( text ), "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+		m_isFirstEvent ? "" : ",\n", name, event.threadId,
+		double( event.startTime - m_startTime ) * 0.001, double( event.endTime - event.startTime ) * 0.001 );
+	Write( text, length );
+	m_isFirstEvent = false;
+}
+
+/*
+====================================================
+TraceRecorder::Write
+====================================================
+*/
+void TraceRecorder::Write( const char * text, const int length ) {
+	if ( m_bufferUsed + length > BUFFER_SIZE ) {
+		Flush();
+	}
+	memcpy( m_buffer + m_bufferUsed, text, length );
+	m_bufferUsed += length;
+}
+
+/*
+====================================================
+TraceRecorder::Flush
+====================================================
+*/
+void TraceRecorder::Flush() {
+	if ( m_bufferUsed > 0 ) {
+		fwrite( m_buffer, 1, m_bufferUsed, m_file );
+		m_bufferUsed = 0;
+	}
+}
@@ -0,0 +1,44 @@
+//
+//  TraceRecorder.h
+//
+#pragma once
+#include "Profiler.h"
+#include <stdio.h>
+#include <vector>
+
+/*
+====================================================
+TraceRecorder
+// Streams every profiler event to a file in the Chrome trace event format,
+// for chrome://tracing or Perfetto. Events are written as Profiler::Collect
+// drains them, through a fixed size buffer, so a long capture doesn't grow
+// in memory.
+====================================================
+*/
+class TraceRecorder {
+public:
+	TraceRecorder();
+	~TraceRecorder();
+
+	bool Begin( const char * fileName );
+	void End();
+	bool IsRecording() const { return NULL != m_file; }
+
+private:
+	TraceRecorder( const TraceRecorder & );
+	TraceRecorder & operator = ( const TraceRecorder & );
+
+	static void OnEvent( const profileEvent_t & event, const char * zoneName, const char * threadName, void * userData );
+	void WriteEvent( const profileEvent_t & event, const char * zoneName, const char * threadName );
+	void Write( const char * text, const int length );
+	void Flush();
+
+	static const int BUFFER_SIZE = 256 * 1024;
+
+	FILE * m_file;
+	char * m_buffer;
+	int m_bufferUsed;
+	int64_t m_startTime;
+	bool m_isFirstEvent;
+	std::vector< bool > m_isThreadNamed;	// by profiler thread id
+};
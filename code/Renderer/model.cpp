@@ -6,6 +6,7 @@
 #include "../Fileio.h"
 #include <string.h>
 #include "../Physics/Shapes.h"
+#include "../Physics/Shapes/ShapeHeightfield.h"
 #include <algorithm>
 
 #pragma warning( disable : 4996 )
@@ -484,6 +485,73 @@ bool Model::BuildFromShape( const Shape * shape ) {
 			m_indices.push_back( hullTris[ i ].b );
 			m_indices.push_back( hullTris[ i ].c );
 		}
+	} else if ( shape->GetType() == ShapeHeightfield::SHAPE_HEIGHTFIELD ) {
+		const ShapeHeightfield * shapeHeightfield = (const ShapeHeightfield *)shape;
+		const int numX = shapeHeightfield->m_numSamplesX;
+		const int numY = shapeHeightfield->m_numSamplesY;
+		const float cellSize = shapeHeightfield->m_cellSize;
+
+		m_vertices.clear();
+		m_indices.clear();
+
+		// One vertex per sample, the normals and tangents come from the slopes to the neighbouring samples
+		m_vertices.reserve( numX * numY );
+		for ( int y = 0; y < numY; y++ ) {
+			for ( int x = 0; x < numX; x++ ) {
+				const int x0 = std::max( x - 1, 0 );
+				const int x1 = std::min( x + 1, numX - 1 );
+				const int y0 = std::max( y - 1, 0 );
+				const int y1 = std::min( y + 1, numY - 1 );
+				const float slopeX = ( shapeHeightfield->GetHeight( x1, y ) - shapeHeightfield->GetHeight( x0, y ) ) / ( float( x1 - x0 ) * cellSize );
+				const float slopeY = ( shapeHeightfield->GetHeight( x, y1 ) - shapeHeightfield->GetHeight( x, y0 ) ) / ( float( y1 - y0 ) * cellSize );
+
+				Vec3 norm( -slopeX, -slopeY, 1.0f );
+				norm.Normalize();
+				Vec3 tang( 1.0f, 0.0f, slopeX );
+				tang.Normalize();
+
+				vert_t vert;
+				memset( &vert, 0, sizeof( vert_t ) );
+
+				vert.xyz[ 0 ] = float( x ) * cellSize;
+				vert.xyz[ 1 ] = float( y ) * cellSize;
+				vert.xyz[ 2 ] = shapeHeightfield->GetHeight( x, y );
+
+				vert.st[ 0 ] = float( x ) / float( numX - 1 );
+				vert.st[ 1 ] = float( y ) / float( numY - 1 );
+
+				vert.norm[ 0 ] = FloatToByte_n11( norm[ 0 ] );
+				vert.norm[ 1 ] = FloatToByte_n11( norm[ 1 ] );
+				vert.norm[ 2 ] = FloatToByte_n11( norm[ 2 ] );
+				vert.norm[ 3 ] = FloatToByte_n11( 0.0f );
+
+				vert.tang[ 0 ] = FloatToByte_n11( tang[ 0 ] );
+				vert.tang[ 1 ] = FloatToByte_n11( tang[ 1 ] );
+				vert.tang[ 2 ] = FloatToByte_n11( tang[ 2 ] );
+				vert.tang[ 3 ] = FloatToByte_n11( 0.0f );
+
+				m_vertices.push_back( vert );
+			}
+		}
+
+		// Two triangles per cell, split along the same diagonal as the collision
+		m_indices.reserve( ( numX - 1 ) * ( numY - 1 ) * 6 );
+		for ( int y = 0; y < numY - 1; y++ ) {
+			for ( int x = 0; x < numX - 1; x++ ) {
+				const unsigned int i00 = y * numX + x;
+				const unsigned int i10 = i00 + 1;
+				const unsigned int i01 = i00 + numX;
+				const unsigned int i11 = i01 + 1;
+
+				m_indices.push_back( i00 );
+				m_indices.push_back( i10 );
+				m_indices.push_back( i01 );
+
+				m_indices.push_back( i11 );
+				m_indices.push_back( i01 );
+				m_indices.push_back( i10 );
+			}
+		}
 	}
 
 	return true;
@@ -0,0 +1,156 @@
+//
+//  LzCodec.cpp
+//
+#include "LzCodec.h"
+#include <string.h>
+
+static const int MIN_MATCH = 4;
+static const int MAX_OFFSET = 65535;
+static const int HASH_BITS = 14;
+static const int LAST_LITERALS = 5;	// the end of a block is always literals, so the decoder never overreads
+
+static uint32_t Read32( const uint8_t * data ) {
+	uint32_t value;
+	memcpy( &value, data, sizeof( value ) );
+	return value;
+}
+
+static uint32_t Hash( const uint32_t value ) {
+	return ( value * 2654435761u ) >> ( 32 - HASH_BITS );
+}
+
+static void WriteLength( std::vector< uint8_t > & compressed, int length ) {
+	while ( length >= 255 ) {
+		compressed.push_back( 255 );
+		length -= 255;
+	}
+	compressed.push_back( uint8_t( length ) );
+}
+
+static void WriteSequence( std::vector< uint8_t > & compressed, const uint8_t * literals, const int numLiterals, const int offset, const int matchLength ) {
+	// match lengths are stored minus MIN_MATCH, the last sequence has no match at all
+	const int storedMatch = ( matchLength > 0 ) ? ( matchLength - MIN_MATCH ) : 0;
+	const uint8_t token = uint8_t( ( ( numLiterals < 15 ? numLiterals : 15 ) << 4 ) | ( storedMatch < 15 ? storedMatch : 15 ) );
+	compressed.push_back( token );
+	if ( numLiterals >= 15 ) {
+		WriteLength( compressed, numLiterals - 15 );
+	}
+	compressed.insert( compressed.end(), literals, literals + numLiterals );
+	if ( 0 == matchLength ) {
+		return;
+	}
+	compressed.push_back( uint8_t( offset & 0xff ) );
+	compressed.push_back( uint8_t( offset >> 8 ) );
+	if ( storedMatch >= 15 ) {
+		WriteLength( compressed, storedMatch - 15 );
+	}
+}
+
+/*
+====================================================
+LzCompress
+====================================================
+*/
+void LzCompress( const uint8_t * source, const int sourceSize, std::vector< uint8_t > & compressed ) {
+	compressed.clear();
+	compressed.reserve( sourceSize / 2 + 16 );
+
+	int hashTable[ 1 << HASH_BITS ];
+	for ( int i = 0; i < ( 1 << HASH_BITS ); i++ ) {
+		hashTable[ i ] = -1;
+	}
+
+	int anchor = 0;
+	int position = 0;
+	const int matchLimit = sourceSize - LAST_LITERALS;
+	while ( position + MIN_MATCH <= matchLimit ) {
+		const uint32_t sequence = Read32( source + position );
+		const uint32_t hash = Hash( sequence );
+		const int candidate = hashTable[ hash ];
+		hashTable[ hash ] = position;
+
+		if ( candidate < 0 || position - candidate > MAX_OFFSET || Read32( source + candidate ) != sequence ) {
+			position++;
+			continue;
+		}
+
+		int matchLength = MIN_MATCH;
+		while ( position + matchLength < matchLimit && source[ candidate + matchLength ] == source[ position + matchLength ] ) {
+			matchLength++;
+		}
+
+		WriteSequence( compressed, source + anchor, position - anchor, position - candidate, matchLength );
+		position += matchLength;
+		anchor = position;
+	}
+
+	WriteSequence( compressed, source + anchor, sourceSize - anchor, 0, 0 );
+}
+
+/*
+====================================================
+LzDecompress
+====================================================
+*/
+bool LzDecompress( const uint8_t * compressed, const int compressedSize, uint8_t * destination, const int destinationSize ) {
+	const uint8_t * in = compressed;
+	const uint8_t * inEnd = compressed + compressedSize;
+	uint8_t * out = destination;
+	uint8_t * outEnd = destination + destinationSize;
+
+	while ( in < inEnd ) {
+		const uint8_t token = *in++;
+
+		int numLiterals = token >> 4;
+		if ( 15 == numLiterals ) {
+			uint8_t extra;
+			do {
+				if ( in >= inEnd ) {
+					return false;
+				}
+				extra = *in++;
+				numLiterals += extra;
+			} while ( 255 == extra );
+		}
+		if ( numLiterals > inEnd - in || numLiterals > outEnd - out ) {
+			return false;
+		}
+		memcpy( out, in, numLiterals );
+		in += numLiterals;
+		out += numLiterals;
+
+		// the last sequence ends right after its literals
+		if ( in == inEnd ) {
+			break;
+		}
+
+		if ( inEnd - in < 2 ) {
+			return false;
+		}
+		const int offset = in[ 0 ] | ( in[ 1 ] << 8 );
+		in += 2;
+		int matchLength = token & 15;
+		if ( 15 == matchLength ) {
+			uint8_t extra;
+			do {
+				if ( in >= inEnd ) {
+					return false;
+				}
+				extra = *in++;
+				matchLength += extra;
+			} while ( 255 == extra );
+		}
+		matchLength += MIN_MATCH;
+		if ( 0 == offset || offset > out - destination || matchLength > outEnd - out ) {
+			return false;
+		}
+
+		// matches may overlap their own output, so copy byte by byte
+		const uint8_t * match = out - offset;
+		for ( int i = 0; i < matchLength; i++ ) {
+			out[ i ] = match[ i ];
+		}
+		out += matchLength;
+	}
+	return out == outEnd;
+}
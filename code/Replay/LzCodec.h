@@ -0,0 +1,17 @@
+//
+//  LzCodec.h
+//
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+/*
+====================================================
+LZ block codec
+// Byte oriented LZ77 in the style of LZ4: every sequence is a token with
+// the literal and match lengths, the literals, then a 16 bit match offset.
+// Fast enough to run on every replay chunk, nothing fancy in the ratio.
+====================================================
+*/
+void LzCompress( const uint8_t * source, const int sourceSize, std::vector< uint8_t > & compressed );
+bool LzDecompress( const uint8_t * compressed, const int compressedSize, uint8_t * destination, const int destinationSize );
@@ -0,0 +1,170 @@
+//
+//  ReplayFormat.h
+//
+//	Replay files are a header followed by independent chunks:
+//
+//	replayFileHeader_t
+//	replayChunkHeader_t, LZ compressed frames		one chunk per keyframe interval
+//	...
+//
+//	A chunk always starts with a keyframe holding every body, the frames after it
+//	only hold the bodies whose quantized transform changed. Positions are stored
+//	on a fixed grid and orientations as the smallest three quaternion components,
+//	both as zigzag varint deltas against the previous frame of the chunk.
+//
+//	Every frame starts with its type and the scene step it was recorded at, as a
+//	varint offset from the first step of the chunk. The recorder drops frames when
+//	its writer falls behind, so the steps tell where the gaps are.
+//
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+#include "../Math/Vector.h"
+#include "../Math/Quat.h"
+
+#define REPLAY_FILE_MAGIC	0x4c505250	// "PRPL"
+#define REPLAY_FILE_VERSION	2
+
+/*
+====================================================
+replayFileHeader_t
+====================================================
+*/
+struct replayFileHeader_t {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t keyframeInterval;
+	float positionScale;	// grid cells per meter
+};
+
+/*
+====================================================
+replayChunkHeader_t
+====================================================
+*/
+struct replayChunkHeader_t {
+	uint32_t firstFrame;
+	uint32_t numFrames;
+	uint32_t rawSize;
+	uint32_t compressedSize;
+	int64_t firstStep;	// Scene::GetStepStats().step of the keyframe
+};
+
+enum replayFrameType_t {
+	REPLAY_FRAME_DELTA = 0,
+	REPLAY_FRAME_KEY = 1,
+};
+
+/*
+====================================================
+quantizedTransform_t
+====================================================
+*/
+struct quantizedTransform_t {
+	int32_t position[ 3 ];
+	int32_t orientation[ 3 ];	// the three smallest components
+	int32_t largestIndex;		// which component was left out, it's always positive
+};
+
+/*
+====================================================
+Quantization
+====================================================
+*/
+static const float REPLAY_ORIENTATION_SCALE = 32767.0f * 1.41421356f;	// the smallest three are within +-1/sqrt(2)
+
+inline int32_t QuantizeFloat( const float value, const float scale ) {
+	const float scaled = value * scale;
+	if ( !( scaled > -2147483520.0f ) ) {
+		return -2147483520;		// also catches NaN
+	}
+	if ( scaled > 2147483520.0f ) {
+		return 2147483520;
+	}
+	return int32_t( lrintf( scaled ) );
+}
+
+inline void QuantizeTransform( const Vec3 & position, const Quat & orientation, const float positionScale, quantizedTransform_t & quantized ) {
+	quantized.position[ 0 ] = QuantizeFloat( position.x, positionScale );
+	quantized.position[ 1 ] = QuantizeFloat( position.y, positionScale );
+	quantized.position[ 2 ] = QuantizeFloat( position.z, positionScale );
+
+	float components[ 4 ] = { orientation.x, orientation.y, orientation.z, orientation.w };
+	int largestIndex = 0;
+	for ( int i = 1; i < 4; i++ ) {
+		if ( fabsf( components[ i ] ) > fabsf( components[ largestIndex ] ) ) {
+			largestIndex = i;
+		}
+	}
+
+	// q and -q are the same rotation, flip it so the dropped component is positive
+	const float sign = ( components[ largestIndex ] < 0.0f ) ? -1.0f : 1.0f;
+	int outIndex = 0;
+	for ( int i = 0; i < 4; i++ ) {
+		if ( i != largestIndex ) {
+			quantized.orientation[ outIndex++ ] = QuantizeFloat( components[ i ] * sign, REPLAY_ORIENTATION_SCALE );
+		}
+	}
+	quantized.largestIndex = largestIndex;
+}
+
+inline void DequantizeTransform( const quantizedTransform_t & quantized, const float positionScale, Vec3 & position, Quat & orientation ) {
+	const float invPositionScale = 1.0f / positionScale;
+	position.x = float( quantized.position[ 0 ] ) * invPositionScale;
+	position.y = float( quantized.position[ 1 ] ) * invPositionScale;
+	position.z = float( quantized.position[ 2 ] ) * invPositionScale;
+
+	float components[ 4 ];
+	float lengthSqr = 0.0f;
+	int inIndex = 0;
+	for ( int i = 0; i < 4; i++ ) {
+		if ( i == quantized.largestIndex ) {
+			continue;
+		}
+		components[ i ] = float( quantized.orientation[ inIndex++ ] ) / REPLAY_ORIENTATION_SCALE;
+		lengthSqr += components[ i ] * components[ i ];
+	}
+	components[ quantized.largestIndex ] = ( lengthSqr < 1.0f ) ? sqrtf( 1.0f - lengthSqr ) : 0.0f;
+	orientation = Quat( components[ 0 ], components[ 1 ], components[ 2 ], components[ 3 ] );
+}
+
+/*
+====================================================
+Varints
+====================================================
+*/
+inline void WriteVarint( std::vector< uint8_t > & buffer, uint32_t value ) {
+	while ( value >= 0x80 ) {
+		buffer.push_back( uint8_t( value | 0x80 ) );
+		value >>= 7;
+	}
+	buffer.push_back( uint8_t( value ) );
+}
+
+inline void WriteZigzag( std::vector< uint8_t > & buffer, const int32_t value ) {
+	WriteVarint( buffer, ( uint32_t( value ) << 1 ) ^ uint32_t( value >> 31 ) );
+}
+
+// returns false when the buffer ends in the middle of the varint
+inline bool ReadVarint( const uint8_t *& data, const uint8_t * end, uint32_t & value ) {
+	value = 0;
+	for ( int shift = 0; shift < 35 && data < end; shift += 7 ) {
+		const uint8_t byte = *data++;
+		value |= uint32_t( byte & 0x7f ) << shift;
+		if ( 0 == ( byte & 0x80 ) ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+inline bool ReadZigzag( const uint8_t *& data, const uint8_t * end, int32_t & value ) {
+	uint32_t encoded;
+	if ( !ReadVarint( data, end, encoded ) ) {
+		return false;
+	}
+	value = int32_t( encoded >> 1 ) ^ -int32_t( encoded & 1 );
+	return true;
+}
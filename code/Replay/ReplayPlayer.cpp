@@ -0,0 +1,296 @@
+//
+//  ReplayPlayer.cpp
+//
+#include "ReplayPlayer.h"
+#include "LzCodec.h"
+#include <string.h>
+
+/*
+====================================================
+ReplayPlayer::ReplayPlayer
+====================================================
+*/
+ReplayPlayer::ReplayPlayer() :
+	m_file( NULL ),
+	m_numFrames( 0 ),
+	m_loadedChunk( -1 ),
+	m_readOffset( 0 ),
+	m_currentFrame( -1 ),
+	m_currentStep( -1 ) {
+	memset( &m_header, 0, sizeof( m_header ) );
+}
+
+/*
+====================================================
+ReplayPlayer::~ReplayPlayer
+====================================================
+*/
+ReplayPlayer::~ReplayPlayer() {
+	Close();
+}
+
+/*
+====================================================
+ReplayPlayer::Open
+====================================================
+*/
+bool ReplayPlayer::Open( const char * fileName ) {
+	Close();
+
+	m_file = fopen( fileName, "rb" );
+	if ( NULL == m_file ) {
+		return false;
+	}
+
+	if ( 1 != fread( &m_header, sizeof( m_header ), 1, m_file ) || REPLAY_FILE_MAGIC != m_header.magic ||
+		REPLAY_FILE_VERSION != m_header.version || !( m_header.positionScale > 0.0f ) ) {
+		printf( "ReplayPlayer: %s isn't a version %u replay\n", fileName, REPLAY_FILE_VERSION );
+		Close();
+		return false;
+	}
+
+	// only the chunk headers are read up front
+	fseek( m_file, 0, SEEK_END );
+	const long fileSize = ftell( m_file );
+	long offset = sizeof( m_header );
+	while ( offset + long( sizeof( replayChunkHeader_t ) ) <= fileSize ) {
+		chunk_t chunk;
+		fseek( m_file, offset, SEEK_SET );
+		if ( 1 != fread( &chunk.header, sizeof( chunk.header ), 1, m_file ) ) {
+			break;
+		}
+		chunk.fileOffset = offset + sizeof( replayChunkHeader_t );
+		if ( chunk.fileOffset + long( chunk.header.compressedSize ) > fileSize || chunk.header.firstFrame != uint32_t( m_numFrames ) ) {
+			break;
+		}
+		m_chunks.push_back( chunk );
+		m_numFrames += chunk.header.numFrames;
+		offset = chunk.fileOffset + chunk.header.compressedSize;
+	}
+	return true;
+}
+
+/*
+====================================================
+ReplayPlayer::Close
+====================================================
+*/
+void ReplayPlayer::Close() {
+	if ( NULL != m_file ) {
+		fclose( m_file );
+		m_file = NULL;
+	}
+	m_chunks.clear();
+	m_numFrames = 0;
+	m_loadedChunk = -1;
+	m_currentFrame = -1;
+	m_currentStep = -1;
+	m_transforms.clear();
+}
+
+/*
+====================================================
+ReplayPlayer::SeekFrame
+====================================================
+*/
+bool ReplayPlayer::SeekFrame( const int frame ) {
+	if ( frame < 0 || frame >= m_numFrames ) {
+		return false;
+	}
+
+	// the last chunk that starts at or before the frame
+	int first = 0;
+	int last = static_cast< int >( m_chunks.size() ) - 1;
+	while ( first < last ) {
+		const int middle = ( first + last + 1 ) / 2;
+		if ( m_chunks[ middle ].header.firstFrame <= uint32_t( frame ) ) {
+			first = middle;
+		} else {
+			last = middle - 1;
+		}
+	}
+	const int chunkIndex = first;
+
+	if ( chunkIndex != m_loadedChunk || frame < m_currentFrame ) {
+		if ( !LoadChunk( chunkIndex ) ) {
+			return false;
+		}
+	}
+	while ( m_currentFrame < frame ) {
+		if ( !DecodeFrame() ) {
+			m_loadedChunk = -1;
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+====================================================
+ReplayPlayer::SeekStep
+====================================================
+*/
+bool ReplayPlayer::SeekStep( const int64_t step ) {
+	// steps only go back after a restore, which starts a new chunk, so the last chunk starting at or before the step holds it
+	int chunkIndex = static_cast< int >( m_chunks.size() ) - 1;
+	while ( chunkIndex >= 0 && m_chunks[ chunkIndex ].header.firstStep > step ) {
+		chunkIndex--;
+	}
+	if ( chunkIndex < 0 ) {
+		return false;
+	}
+
+	if ( chunkIndex != m_loadedChunk || step < m_currentStep ) {
+		if ( !LoadChunk( chunkIndex ) ) {
+			return false;
+		}
+	}
+	int64_t nextStep;
+	while ( m_currentStep < step && PeekStep( nextStep ) && nextStep <= step ) {
+		if ( !DecodeFrame() ) {
+			m_loadedChunk = -1;
+			return false;
+		}
+	}
+	return m_currentStep == step;
+}
+
+/*
+====================================================
+ReplayPlayer::GetTransform
+====================================================
+*/
+void ReplayPlayer::GetTransform( const int bodyIndex, Vec3 & position, Quat & orientation ) const {
+	DequantizeTransform( m_transforms[ bodyIndex ], m_header.positionScale, position, orientation );
+}
+
+/*
+====================================================
+ReplayPlayer::LoadChunk
+====================================================
+*/
+bool ReplayPlayer::LoadChunk( const int chunkIndex ) {
+	const chunk_t & chunk = m_chunks[ chunkIndex ];
+	m_loadedChunk = -1;
+
+	m_compressed.resize( chunk.header.compressedSize );
+	m_raw.resize( chunk.header.rawSize );
+	fseek( m_file, chunk.fileOffset, SEEK_SET );
+	if ( chunk.header.compressedSize != fread( m_compressed.data(), 1, chunk.header.compressedSize, m_file ) ) {
+		return false;
+	}
+	if ( !LzDecompress( m_compressed.data(), chunk.header.compressedSize, m_raw.data(), chunk.header.rawSize ) ) {
+		printf( "ReplayPlayer: chunk %i is corrupt\n", chunkIndex );
+		return false;
+	}
+
+	m_loadedChunk = chunkIndex;
+	m_readOffset = 0;
+	m_currentFrame = int( chunk.header.firstFrame ) - 1;
+	m_currentStep = -1;
+	return true;
+}
+
+/*
+====================================================
+ReplayPlayer::DecodeFrame
+====================================================
+*/
+bool ReplayPlayer::DecodeFrame() {
+	const uint8_t * data = m_raw.data() + m_readOffset;
+	const uint8_t * end = m_raw.data() + m_raw.size();
+	if ( data >= end ) {
+		return false;
+	}
+
+	const uint8_t type = *data++;
+	uint32_t stepOffset;
+	if ( !ReadVarint( data, end, stepOffset ) ) {
+		return false;
+	}
+	if ( REPLAY_FRAME_KEY == type ) {
+		uint32_t numBodies;
+		if ( !ReadVarint( data, end, numBodies ) || numBodies > uint32_t( end - data ) ) {
+			return false;
+		}
+		m_transforms.resize( numBodies );
+		for ( uint32_t i = 0; i < numBodies; i++ ) {
+			quantizedTransform_t & transform = m_transforms[ i ];
+			for ( int axis = 0; axis < 3; axis++ ) {
+				if ( !ReadZigzag( data, end, transform.position[ axis ] ) ) {
+					return false;
+				}
+			}
+			if ( data >= end ) {
+				return false;
+			}
+			transform.largestIndex = *data++ & 3;
+			for ( int axis = 0; axis < 3; axis++ ) {
+				if ( !ReadZigzag( data, end, transform.orientation[ axis ] ) ) {
+					return false;
+				}
+			}
+		}
+	} else if ( REPLAY_FRAME_DELTA == type ) {
+		uint32_t numMoved;
+		if ( !ReadVarint( data, end, numMoved ) ) {
+			return false;
+		}
+		uint32_t bodyIndex = uint32_t( -1 );
+		for ( uint32_t i = 0; i < numMoved; i++ ) {
+			uint32_t skipped;
+			if ( !ReadVarint( data, end, skipped ) ) {
+				return false;
+			}
+			bodyIndex += skipped + 1;
+			if ( bodyIndex >= m_transforms.size() ) {
+				return false;
+			}
+
+			quantizedTransform_t & transform = m_transforms[ bodyIndex ];
+			int32_t delta;
+			for ( int axis = 0; axis < 3; axis++ ) {
+				if ( !ReadZigzag( data, end, delta ) ) {
+					return false;
+				}
+				transform.position[ axis ] = int32_t( uint32_t( transform.position[ axis ] ) + uint32_t( delta ) );
+			}
+			if ( data >= end ) {
+				return false;
+			}
+			transform.largestIndex = *data++ & 3;
+			for ( int axis = 0; axis < 3; axis++ ) {
+				if ( !ReadZigzag( data, end, delta ) ) {
+					return false;
+				}
+				transform.orientation[ axis ] = int32_t( uint32_t( transform.orientation[ axis ] ) + uint32_t( delta ) );
+			}
+		}
+	} else {
+		return false;
+	}
+
+	m_readOffset = data - m_raw.data();
+	m_currentFrame++;
+	m_currentStep = m_chunks[ m_loadedChunk ].header.firstStep + stepOffset;
+	return true;
+}
+
+/*
+====================================================
+ReplayPlayer::PeekStep
+====================================================
+*/
+bool ReplayPlayer::PeekStep( int64_t & step ) const {
+	if ( m_loadedChunk < 0 || m_readOffset >= m_raw.size() ) {
+		return false;
+	}
+	const uint8_t * data = m_raw.data() + m_readOffset + 1;	// past the frame type
+	const uint8_t * end = m_raw.data() + m_raw.size();
+	uint32_t stepOffset;
+	if ( !ReadVarint( data, end, stepOffset ) ) {
+		return false;
+	}
+	step = m_chunks[ m_loadedChunk ].header.firstStep + stepOffset;
+	return true;
+}
@@ -0,0 +1,64 @@
+//
+//  ReplayPlayer.h
+//
+#pragma once
+#include <stdio.h>
+#include <vector>
+
+#include "ReplayFormat.h"
+
+/*
+====================================================
+ReplayPlayer
+// Plays back a file of the ReplayRecorder without simulating. Seeking
+// decodes from the keyframe that starts the chunk of the frame, playing
+// forward keeps decoding from where the last seek stopped. Frames are the
+// records in the file, steps are the scene steps they were recorded at,
+// the two differ once the recorder dropped frames.
+====================================================
+*/
+class ReplayPlayer {
+public:
+	ReplayPlayer();
+	~ReplayPlayer();
+
+	bool Open( const char * fileName );	// a file that was cut off plays up to the last complete chunk
+	void Close();
+
+	int GetNumFrames() const { return m_numFrames; }
+	int GetCurrentFrame() const { return m_currentFrame; }	// -1 before the first seek
+	int64_t GetCurrentStep() const { return m_currentStep; }
+	bool SeekFrame( const int frame );
+	// False when the step wasn't recorded, the player then shows the last recorded step before it.
+	// After a snapshot restore during recording a step can be in the file twice, this finds the later one
+	bool SeekStep( const int64_t step );
+
+	int GetNumBodies() const { return static_cast< int >( m_transforms.size() ); }
+	void GetTransform( const int bodyIndex, Vec3 & position, Quat & orientation ) const;
+
+private:
+	ReplayPlayer( const ReplayPlayer & );
+	ReplayPlayer & operator = ( const ReplayPlayer & );
+
+	struct chunk_t {
+		replayChunkHeader_t header;
+		long fileOffset;	// of the compressed data
+	};
+
+	bool LoadChunk( const int chunkIndex );
+	bool DecodeFrame();
+	bool PeekStep( int64_t & step ) const;	// of the next frame in the loaded chunk
+
+	FILE * m_file;
+	replayFileHeader_t m_header;
+	std::vector< chunk_t > m_chunks;
+	int m_numFrames;
+
+	int m_loadedChunk;
+	std::vector< uint8_t > m_compressed;
+	std::vector< uint8_t > m_raw;
+	size_t m_readOffset;	// of the next frame in m_raw
+	int m_currentFrame;
+	int64_t m_currentStep;
+	std::vector< quantizedTransform_t > m_transforms;
+};
@@ -0,0 +1,280 @@
+//
+//  ReplayRecorder.cpp
+//
+#include "ReplayRecorder.h"
+#include "LzCodec.h"
+#include "../Scene.h"
+#include <string.h>
+
+/*
+====================================================
+ReplayRecorder::ReplayRecorder
+====================================================
+*/
+ReplayRecorder::ReplayRecorder() :
+	m_file( NULL ),
+	m_quit( false ),
+	m_hasWriteFailed( false ),
+	m_numFrames( 0 ),
+	m_numDroppedFrames( 0 ),
+	m_frameIndex( 0 ),
+	m_chunkFirstFrame( 0 ),
+	m_chunkNumFrames( 0 ),
+	m_chunkFirstStep( 0 ),
+	m_previousStep( 0 ) {
+	memset( &m_header, 0, sizeof( m_header ) );
+}
+
+/*
+====================================================
+ReplayRecorder::~ReplayRecorder
+====================================================
+*/
+ReplayRecorder::~ReplayRecorder() {
+	End();
+	for ( int i = 0; i < m_freeFrames.size(); i++ ) {
+		delete m_freeFrames[ i ];
+	}
+}
+
+/*
+====================================================
+ReplayRecorder::Begin
+====================================================
+*/
+bool ReplayRecorder::Begin( const char * fileName, const int keyframeInterval, const float positionResolution ) {
+	End();
+
+	m_file = fopen( fileName, "wb" );
+	if ( NULL == m_file ) {
+		return false;
+	}
+
+	m_header.magic = REPLAY_FILE_MAGIC;
+	m_header.version = REPLAY_FILE_VERSION;
+	m_header.keyframeInterval = ( keyframeInterval > 0 ) ? keyframeInterval : 1;
+	m_header.positionScale = 1.0f / positionResolution;
+	if ( 1 != fwrite( &m_header, sizeof( m_header ), 1, m_file ) ) {
+		printf( "ReplayRecorder: can't write to %s\n", fileName );
+		fclose( m_file );
+		m_file = NULL;
+		return false;
+	}
+
+	m_hasWriteFailed = false;
+	m_numFrames = 0;
+	m_numDroppedFrames = 0;
+	m_frameIndex = 0;
+	m_chunkNumFrames = 0;
+	m_chunk.clear();
+	m_previousHandles.clear();
+	m_quit = false;
+	m_writer = std::thread( &ReplayRecorder::WriterMain, this );
+	return true;
+}
+
+/*
+====================================================
+ReplayRecorder::End
+====================================================
+*/
+void ReplayRecorder::End() {
+	if ( NULL == m_file ) {
+		return;
+	}
+
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		m_quit = true;
+	}
+	m_condition.notify_one();
+	m_writer.join();
+
+	// a failed writer leaves its frames behind
+	for ( int i = 0; i < m_queuedFrames.size(); i++ ) {
+		m_freeFrames.push_back( m_queuedFrames[ i ] );
+	}
+	m_queuedFrames.clear();
+
+	fclose( m_file );
+	m_file = NULL;
+}
+
+/*
+====================================================
+ReplayRecorder::RecordFrame
+====================================================
+*/
+void ReplayRecorder::RecordFrame( const Scene & scene ) {
+	if ( !IsRecording() ) {
+		return;
+	}
+
+	frame_t * frame = NULL;
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		// the simulation never waits on the disk, and a slow disk can't make the queue grow without bound
+		if ( m_queuedFrames.size() >= MAX_QUEUED_FRAMES ) {
+			m_numDroppedFrames++;
+			return;
+		}
+		if ( !m_freeFrames.empty() ) {
+			frame = m_freeFrames.back();
+			m_freeFrames.pop_back();
+		}
+	}
+	if ( NULL == frame ) {
+		frame = new frame_t;
+	}
+
+	const int numBodies = static_cast< int >( scene.m_bodies.size() );
+	frame->step = scene.GetStepStats().step;
+	frame->positions.resize( numBodies );
+	frame->orientations.resize( numBodies );
+	frame->handles.resize( numBodies );
+	for ( int i = 0; i < numBodies; i++ ) {
+		frame->positions[ i ] = scene.m_bodies[ i ].m_position;
+		frame->orientations[ i ] = scene.m_bodies[ i ].m_orientation;
+		frame->handles[ i ] = scene.GetBodyHandle( i );
+	}
+
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		m_queuedFrames.push_back( frame );
+	}
+	m_condition.notify_one();
+	m_numFrames++;
+}
+
+/*
+====================================================
+ReplayRecorder::WriterMain
+====================================================
+*/
+void ReplayRecorder::WriterMain() {
+	while ( true ) {
+		frame_t * frame = NULL;
+		{
+			std::unique_lock< std::mutex > lock( m_mutex );
+			m_condition.wait( lock, [ this ] { return m_quit || !m_queuedFrames.empty(); } );
+			if ( m_queuedFrames.empty() ) {
+				break;	// quitting and everything is written
+			}
+			frame = m_queuedFrames.front();
+			m_queuedFrames.pop_front();
+		}
+
+		EncodeFrame( *frame );
+
+		std::lock_guard< std::mutex > lock( m_mutex );
+		m_freeFrames.push_back( frame );
+		if ( m_hasWriteFailed ) {
+			return;
+		}
+	}
+
+	if ( m_chunkNumFrames > 0 ) {
+		FlushChunk();
+	}
+}
+
+/*
+====================================================
+ReplayRecorder::EncodeFrame
+====================================================
+*/
+void ReplayRecorder::EncodeFrame( const frame_t & frame ) {
+	const int numBodies = static_cast< int >( frame.positions.size() );
+
+	// deltas are per dense index, so any add or remove starts a new keyframe, and so does a step that went back after a restore
+	bool isKeyframe = ( 0 == m_chunkNumFrames || m_chunkNumFrames >= m_header.keyframeInterval || numBodies != m_previousHandles.size() ||
+		frame.step <= m_previousStep );
+	for ( int i = 0; i < numBodies && !isKeyframe; i++ ) {
+		isKeyframe = ( frame.handles[ i ] != m_previousHandles[ i ] );
+	}
+	if ( isKeyframe && m_chunkNumFrames > 0 && !FlushChunk() ) {
+		return;
+	}
+	if ( isKeyframe ) {
+		m_chunkFirstFrame = m_frameIndex;
+		m_chunkFirstStep = frame.step;
+		m_previousHandles = frame.handles;
+		m_previousTransforms.resize( numBodies );
+
+		m_chunk.push_back( REPLAY_FRAME_KEY );
+		WriteVarint( m_chunk, 0 );
+		WriteVarint( m_chunk, numBodies );
+		for ( int i = 0; i < numBodies; i++ ) {
+			quantizedTransform_t & quantized = m_previousTransforms[ i ];
+			QuantizeTransform( frame.positions[ i ], frame.orientations[ i ], m_header.positionScale, quantized );
+			for ( int axis = 0; axis < 3; axis++ ) {
+				WriteZigzag( m_chunk, quantized.position[ axis ] );
+			}
+			m_chunk.push_back( uint8_t( quantized.largestIndex ) );
+			for ( int axis = 0; axis < 3; axis++ ) {
+				WriteZigzag( m_chunk, quantized.orientation[ axis ] );
+			}
+		}
+	} else {
+		// only the bodies that moved by at least one grid step
+		m_frameData.clear();
+		int numMoved = 0;
+		int lastMoved = -1;
+		for ( int i = 0; i < numBodies; i++ ) {
+			quantizedTransform_t quantized;
+			QuantizeTransform( frame.positions[ i ], frame.orientations[ i ], m_header.positionScale, quantized );
+			quantizedTransform_t & previous = m_previousTransforms[ i ];
+			if ( 0 == memcmp( &quantized, &previous, sizeof( quantized ) ) ) {
+				continue;
+			}
+
+			// unsigned math so the deltas wrap instead of overflowing
+			WriteVarint( m_frameData, i - lastMoved - 1 );
+			for ( int axis = 0; axis < 3; axis++ ) {
+				WriteZigzag( m_frameData, int32_t( uint32_t( quantized.position[ axis ] ) - uint32_t( previous.position[ axis ] ) ) );
+			}
+			m_frameData.push_back( uint8_t( quantized.largestIndex ) );
+			for ( int axis = 0; axis < 3; axis++ ) {
+				WriteZigzag( m_frameData, int32_t( uint32_t( quantized.orientation[ axis ] ) - uint32_t( previous.orientation[ axis ] ) ) );
+			}
+			previous = quantized;
+			lastMoved = i;
+			numMoved++;
+		}
+
+		m_chunk.push_back( REPLAY_FRAME_DELTA );
+		WriteVarint( m_chunk, uint32_t( frame.step - m_chunkFirstStep ) );
+		WriteVarint( m_chunk, numMoved );
+		m_chunk.insert( m_chunk.end(), m_frameData.begin(), m_frameData.end() );
+	}
+
+	m_previousStep = frame.step;
+	m_chunkNumFrames++;
+	m_frameIndex++;
+}
+
+/*
+====================================================
+ReplayRecorder::FlushChunk
+====================================================
+*/
+bool ReplayRecorder::FlushChunk() {
+	LzCompress( m_chunk.data(), static_cast< int >( m_chunk.size() ), m_compressed );
+
+	replayChunkHeader_t chunkHeader;
+	chunkHeader.firstFrame = m_chunkFirstFrame;
+	chunkHeader.numFrames = m_chunkNumFrames;
+	chunkHeader.rawSize = static_cast< uint32_t >( m_chunk.size() );
+	chunkHeader.compressedSize = static_cast< uint32_t >( m_compressed.size() );
+	chunkHeader.firstStep = m_chunkFirstStep;
+	m_chunk.clear();
+	m_chunkNumFrames = 0;
+
+	if ( 1 != fwrite( &chunkHeader, sizeof( chunkHeader ), 1, m_file ) ||
+		m_compressed.size() != fwrite( m_compressed.data(), 1, m_compressed.size(), m_file ) ) {
+		printf( "ReplayRecorder: writing the chunk at frame %u failed, recording stopped\n", chunkHeader.firstFrame );
+		m_hasWriteFailed = true;
+		return false;
+	}
+	return true;
+}
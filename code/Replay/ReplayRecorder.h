@@ -0,0 +1,82 @@
+//
+//  ReplayRecorder.h
+//
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#include "ReplayFormat.h"
+#include "../Physics/BodyHandles.h"
+
+class Scene;
+
+/*
+====================================================
+ReplayRecorder
+// Records the body transforms of every Scene::Update. The simulation thread
+// only copies the transforms into a pooled frame, a writer thread quantizes,
+// delta encodes, compresses and writes them. When the writer falls behind
+// new frames are dropped, every frame keeps its step so playback still
+// seeks to the right one. When a write fails the recording stops.
+====================================================
+*/
+class ReplayRecorder {
+public:
+	ReplayRecorder();
+	~ReplayRecorder();
+
+	// positionResolution is the size of the position grid in meters
+	bool Begin( const char * fileName, const int keyframeInterval = 60, const float positionResolution = 1.0f / 1024.0f );
+	void End();		// writes the frames that are still queued
+	bool IsRecording() const { return NULL != m_file && !m_hasWriteFailed; }
+
+	void RecordFrame( const Scene & scene );
+	int64_t GetNumFrames() const { return m_numFrames; }
+	int64_t GetNumDroppedFrames() const { return m_numDroppedFrames; }
+
+	static const int MAX_QUEUED_FRAMES = 120;
+
+private:
+	ReplayRecorder( const ReplayRecorder & );
+	ReplayRecorder & operator = ( const ReplayRecorder & );
+
+	struct frame_t {
+		int64_t step;
+		std::vector< Vec3 > positions;
+		std::vector< Quat > orientations;
+		std::vector< bodyHandle_t > handles;
+	};
+
+	void WriterMain();
+	void EncodeFrame( const frame_t & frame );
+	bool FlushChunk();
+
+	FILE * m_file;
+	std::thread m_writer;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::deque< frame_t * > m_queuedFrames;
+	std::vector< frame_t * > m_freeFrames;	// recycled so recording doesn't allocate once it's warmed up
+	bool m_quit;
+	std::atomic< bool > m_hasWriteFailed;
+	int64_t m_numFrames;
+	int64_t m_numDroppedFrames;
+
+	// only touched by the writer thread
+	replayFileHeader_t m_header;
+	uint32_t m_frameIndex;
+	uint32_t m_chunkFirstFrame;
+	uint32_t m_chunkNumFrames;
+	int64_t m_chunkFirstStep;
+	int64_t m_previousStep;
+	std::vector< quantizedTransform_t > m_previousTransforms;
+	std::vector< bodyHandle_t > m_previousHandles;
+	std::vector< uint8_t > m_chunk;
+	std::vector< uint8_t > m_frameData;
+	std::vector< uint8_t > m_compressed;
+};
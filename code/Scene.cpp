@@ -5,6 +5,13 @@
 #include "Physics/Contact.h"
 #include "Physics/Intersections.h"
 #include "Physics/Broadphase.h"
+#include "Threading/JobSystem.h"
+#include "Profiler/Profiler.h"
+#include "Replay/ReplayRecorder.h"
+#include "Clock.h"
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
 
 /*
 ========================================================================================================
@@ -14,16 +21,82 @@ Scene
 ========================================================================================================
 */
 
+/*
+====================================================
+Scene::Scene
+====================================================
+*/
+Scene::Scene(const int numThreads) :
+	m_isUpdating(false),
+	m_jobSystem(NULL),
+	m_updateGraph(NULL),
+	m_updateDeltaSecond(0.0f),
+	m_isDeterministic(false),
+	m_stateHash(0),
+	m_stepStatsWriter(NULL),
+	m_replayRecorder(NULL),
+	m_scratch(&m_ownScratch),
+	m_numContacts(0),
+	m_reorderInterval(0),
+	m_reorderMilliseconds(0.0f),
+	m_bodyIntegration(DEFAULT_BODY_INTEGRATION),
+	m_ccdMotionFraction(0.25f),
+	m_isQueryTreeValid(false),
+	m_fixedDeltaSecond(1.0f / 120.0f),
+	m_maxStepsPerFrame(4),
+	m_accumulator(0.0f),
+	m_interpolationAlpha(1.0f),
+	m_degradationLevel(0),
+	m_degradations(0),
+	m_numCalmSteps(0),
+	m_averageUpdateSecond(0.0) {
+	m_bodies.reserve(128);
+	memset(&m_stepStats, 0, sizeof(m_stepStats));
+
+	// a single thread runs the stages directly, without any scheduling
+	if (numThreads > 1) {
+		m_jobSystem = new JobSystem(numThreads);
+		BuildUpdateGraph();
+	}
+}
+
 /*
 ====================================================
 Scene::~Scene
 ====================================================
 */
 Scene::~Scene() {
-	for (int i = 0; i < m_bodies.size(); i++) {
-		delete m_bodies[i].m_shape;
-	}
 	m_bodies.clear();
+	m_shapes.Clear();
+
+	delete m_updateGraph;
+	m_updateGraph = NULL;
+	delete m_jobSystem;
+	m_jobSystem = NULL;
+}
+
+/*
+====================================================
+Scene::BuildUpdateGraph
+====================================================
+*/
+void Scene::BuildUpdateGraph() {
+	// every stage needs the full output of the previous one, the parallelism is within the stages
+	m_updateGraph = new TaskGraph;
+	TaskGraph& graph = *m_updateGraph;
+	const int gravity = graph.AddTask("Gravity", [this] { ApplyGravity(m_updateDeltaSecond); });
+	const int broadPhase = graph.AddTask("BroadPhase", [this] { UpdateBroadPhase(m_updateDeltaSecond); });
+	const int narrowPhase = graph.AddTask("NarrowPhase", [this] { UpdateNarrowPhase(m_updateDeltaSecond); });
+	const int sortContacts = graph.AddTask("SortContacts", [this] { SortContacts(); });
+	const int resolveContacts = graph.AddTask("ResolveContacts", [this] { ResolveContacts(m_updateDeltaSecond); });
+	const int sensors = graph.AddTask("Sensors", [this] { UpdateSensors(); });
+	const int sleep = graph.AddTask("Sleep", [this] { UpdateSleep(); });
+	graph.AddDependency(broadPhase, gravity);
+	graph.AddDependency(narrowPhase, broadPhase);
+	graph.AddDependency(sortContacts, narrowPhase);
+	graph.AddDependency(resolveContacts, sortContacts);
+	graph.AddDependency(sensors, resolveContacts);
+	graph.AddDependency(sleep, resolveContacts);
 }
 
 /*
@@ -32,10 +105,16 @@ Scene::Reset
 ====================================================
 */
 void Scene::Reset() {
-	for (int i = 0; i < m_bodies.size(); i++) {
-		delete m_bodies[i].m_shape;
-	}
 	m_bodies.clear();
+	m_bodyHandles.Clear();
+	m_ignoredPairs.Clear();
+	m_sensorOverlaps.clear();
+	m_sensorEvents.clear();
+	m_shapes.Clear();
+	m_previousTransforms.clear();
+	m_accumulator = 0.0f;
+	m_interpolationAlpha = 1.0f;
+	InvalidateQueryTree();
 
 	Initialize();
 }
@@ -60,8 +139,9 @@ void Scene::Initialize() {
 			body.m_invMass = 1.0f;
 			body.m_elasticity = 0.5f;
 			body.m_friction = 0.5f;
-			body.m_shape = new ShapeSphere(radius);
-			m_bodies.push_back(body);
+			body.m_shapeIndex = m_shapes.AddSphere(radius);
+			body.m_shape = m_shapes.GetShape(body.m_shapeIndex);
+			AddBody(body);
 		}
 	}
 
@@ -78,10 +158,485 @@ void Scene::Initialize() {
 			body.m_invMass = 0.0f;
 			body.m_elasticity = 0.99f;
 			body.m_friction = 0.5f;
-			body.m_shape = new ShapeSphere(radius);
-			m_bodies.push_back(body);
+			body.m_shapeIndex = m_shapes.AddSphere(radius);
+			body.m_shape = m_shapes.GetShape(body.m_shapeIndex);
+			AddBody(body);
+		}
+	}
+}
+
+/*
+====================================================
+Scene::AddBody
+====================================================
+*/
+bodyHandle_t Scene::AddBody(const Body& body) {
+	// contacts point into m_bodies during a step
+	assert(!m_isUpdating);
+
+	const bodyHandle_t handle = m_bodyHandles.Add();
+	m_bodies.push_back(body);
+	// the previous transforms are either empty or one per body, a new body starts out at rest
+	if (!m_previousTransforms.empty()) {
+		bodyTransform_t transform;
+		transform.position = body.m_position;
+		transform.orientation = body.m_orientation;
+		m_previousTransforms.push_back(transform);
+	}
+	InvalidateQueryTree();
+	return handle;
+}
+
+/*
+====================================================
+Scene::ReserveBodies
+====================================================
+*/
+void Scene::ReserveBodies(const int numBodies) {
+	m_bodies.reserve(numBodies);
+	m_bodyHandles.Reserve(numBodies);
+}
+
+/*
+====================================================
+Scene::SetIgnoreCollision
+====================================================
+*/
+bool Scene::SetIgnoreCollision(const bodyHandle_t handleA, const bodyHandle_t handleB, const bool isIgnored) {
+	assert(!m_isUpdating);
+	if (!m_bodyHandles.IsValid(handleA) || !m_bodyHandles.IsValid(handleB))
+		return false;
+
+	if (isIgnored)
+		m_ignoredPairs.Add(handleA.slot, handleB.slot);
+	else
+		m_ignoredPairs.Remove(handleA.slot, handleB.slot);
+	return true;
+}
+
+/*
+====================================================
+Scene::RemoveBody
+====================================================
+*/
+bool Scene::RemoveBody(const bodyHandle_t handle) {
+	assert(!m_isUpdating);
+
+	const int bodyIndex = m_bodyHandles.Remove(handle);
+	if (bodyIndex < 0)
+		return false;
+	InvalidateQueryTree();
+	m_ignoredPairs.RemoveSlot(handle.slot);
+
+	// swap the last body into the hole, along with anything else stored per body
+	const int lastBodyIndex = static_cast<int>(m_bodies.size()) - 1;
+	m_bodies[bodyIndex] = m_bodies[lastBodyIndex];
+	m_bodies.pop_back();
+
+	if (!m_previousTransforms.empty()) {
+		m_previousTransforms[bodyIndex] = m_previousTransforms[lastBodyIndex];
+		m_previousTransforms.pop_back();
+	}
+	return true;
+}
+
+/*
+====================================================
+Scene::GetBody
+====================================================
+*/
+Body* Scene::GetBody(const bodyHandle_t handle) {
+	const int bodyIndex = m_bodyHandles.GetDenseIndex(handle);
+	if (bodyIndex < 0)
+		return NULL;
+	return &m_bodies[bodyIndex];
+}
+
+/*
+====================================================
+SpreadBits
+// Moves the low 10 bits of x to every third bit
+====================================================
+*/
+static uint32_t SpreadBits(uint32_t x) {
+	x &= 0x3ff;
+	x = (x | (x << 16)) & 0x030000ff;
+	x = (x | (x << 8)) & 0x0300f00f;
+	x = (x | (x << 4)) & 0x030c30c3;
+	x = (x | (x << 2)) & 0x09249249;
+	return x;
+}
+
+/*
+====================================================
+Scene::ReorderBodies
+====================================================
+*/
+void Scene::ReorderBodies() {
+	assert(!m_isUpdating);
+	PROFILE_SCOPE("ReorderBodies");
+	const int64_t startTime = GetTimeNanoseconds();
+
+	const int numBodies = static_cast<int>(m_bodies.size());
+	if (numBodies < 2)
+		return;
+
+	Vec3 boundsMin = m_bodies[0].m_position;
+	Vec3 boundsMax = m_bodies[0].m_position;
+	for (int currentBodyIndex = 1; currentBodyIndex < numBodies; ++currentBodyIndex) {
+		const Vec3& position = m_bodies[currentBodyIndex].m_position;
+		for (int axis = 0; axis < 3; ++axis) {
+			boundsMin[axis] = std::min(boundsMin[axis], position[axis]);
+			boundsMax[axis] = std::max(boundsMax[axis], position[axis]);
+		}
+	}
+	Vec3 scale;
+	for (int axis = 0; axis < 3; ++axis) {
+		const float extent = boundsMax[axis] - boundsMin[axis];
+		scale[axis] = (extent > 0.0f) ? 1023.0f / extent : 0.0f;
+	}
+
+	// 30 bit Morton code above the body index, the index keeps the keys unique so the order is deterministic
+	m_scratch->mortonKeys.resize(numBodies);
+	auto computeKeys = [this, boundsMin, scale](int begin, int end) {
+		for (int currentBodyIndex = begin; currentBodyIndex < end; ++currentBodyIndex) {
+			const Vec3 cell = m_bodies[currentBodyIndex].m_position - boundsMin;
+			const uint32_t x = static_cast<uint32_t>(cell.x * scale.x);
+			const uint32_t y = static_cast<uint32_t>(cell.y * scale.y);
+			const uint32_t z = static_cast<uint32_t>(cell.z * scale.z);
+			const uint32_t code = SpreadBits(x) | (SpreadBits(y) << 1) | (SpreadBits(z) << 2);
+			m_scratch->mortonKeys[currentBodyIndex] = (static_cast<uint64_t>(code) << 32) | static_cast<uint32_t>(currentBodyIndex);
+		}
+	};
+	if (NULL != m_jobSystem)
+		m_jobSystem->ParallelFor(numBodies, 4096, computeKeys);
+	else
+		computeKeys(0, numBodies);
+	std::sort(m_scratch->mortonKeys.begin(), m_scratch->mortonKeys.end());
+
+	m_scratch->newToOld.resize(numBodies);
+	bool isSorted = true;
+	for (int currentBodyIndex = 0; currentBodyIndex < numBodies; ++currentBodyIndex) {
+		m_scratch->newToOld[currentBodyIndex] = static_cast<int>(m_scratch->mortonKeys[currentBodyIndex] & 0xffffffff);
+		isSorted = isSorted && (m_scratch->newToOld[currentBodyIndex] == currentBodyIndex);
+	}
+
+	if (!isSorted) {
+		// everything stored per dense index moves along with the bodies, the rest is keyed by handle or slot
+		m_scratch->reorderedBodies.resize(numBodies);
+		for (int currentBodyIndex = 0; currentBodyIndex < numBodies; ++currentBodyIndex)
+			m_scratch->reorderedBodies[currentBodyIndex] = m_bodies[m_scratch->newToOld[currentBodyIndex]];
+		m_bodies.swap(m_scratch->reorderedBodies);
+		m_bodyHandles.Reorder(m_scratch->newToOld.data());
+
+		if (m_previousTransforms.size() == m_bodies.size()) {
+			m_scratch->reorderedTransforms.resize(numBodies);
+			for (int currentBodyIndex = 0; currentBodyIndex < numBodies; ++currentBodyIndex)
+				m_scratch->reorderedTransforms[currentBodyIndex] = m_previousTransforms[m_scratch->newToOld[currentBodyIndex]];
+			m_previousTransforms.swap(m_scratch->reorderedTransforms);
+		}
+
+		InvalidateQueryTree();
+		if (m_isDeterministic)
+			m_stateHash = ComputeStateHash();
+	}
+
+	m_reorderMilliseconds += float(double(GetTimeNanoseconds() - startTime) * 1.0e-6);
+}
+
+/*
+====================================================
+Scene::SaveState
+====================================================
+*/
+void Scene::SaveState(SceneSnapshot& snapshot) const {
+	assert(!m_isUpdating);
+
+	// resize and assign keep the capacity, so a snapshot reserved for the scene never allocates here
+	const int numBodies = static_cast<int>(m_bodies.size());
+	snapshot.m_handles.resize(numBodies);
+	snapshot.m_bodyStates.resize(numBodies);
+
+	for (int currentBodyIndex = 0; currentBodyIndex < numBodies; ++currentBodyIndex) {
+		const Body& body = m_bodies[currentBodyIndex];
+		bodyState_t& state = snapshot.m_bodyStates[currentBodyIndex];
+		state.position = body.m_position;
+		state.orientation = body.m_orientation;
+		state.linearVelocity = body.m_linearVelocity;
+		state.angularVelocity = body.m_angularVelocity;
+		state.restPosition = body.m_restPosition;
+		state.numRestingSteps = body.m_numRestingSteps;
+		state.isSleeping = body.m_isSleeping;
+		snapshot.m_handles[currentBodyIndex] = m_bodyHandles.GetHandle(currentBodyIndex);
+	}
+	snapshot.m_sensorOverlaps.assign(m_sensorOverlaps.begin(), m_sensorOverlaps.end());
+
+	snapshot.m_step = m_stepStats.step;
+	snapshot.m_accumulator = m_accumulator;
+}
+
+/*
+====================================================
+Scene::RestoreState
+====================================================
+*/
+bool Scene::RestoreState(const SceneSnapshot& snapshot) {
+	assert(!m_isUpdating);
+
+	// the bodies may have been reordered since the save, so the states are matched up by handle
+	const int numBodies = static_cast<int>(m_bodies.size());
+	if (!snapshot.IsValid() || snapshot.GetNumBodies() != numBodies)
+		return false;
+	for (int currentStateIndex = 0; currentStateIndex < numBodies; ++currentStateIndex) {
+		if (!m_bodyHandles.IsValid(snapshot.m_handles[currentStateIndex]))
+			return false;
+	}
+
+	for (int currentStateIndex = 0; currentStateIndex < numBodies; ++currentStateIndex) {
+		Body& body = m_bodies[m_bodyHandles.GetDenseIndex(snapshot.m_handles[currentStateIndex])];
+		const bodyState_t& state = snapshot.m_bodyStates[currentStateIndex];
+		body.m_position = state.position;
+		body.m_orientation = state.orientation;
+		body.m_linearVelocity = state.linearVelocity;
+		body.m_angularVelocity = state.angularVelocity;
+		body.m_restPosition = state.restPosition;
+		body.m_numRestingSteps = state.numRestingSteps;
+		body.m_isSleeping = state.isSleeping;
+	}
+
+	// the sensor overlaps are the only pair state carried between steps
+	m_sensorOverlaps.assign(snapshot.m_sensorOverlaps.begin(), snapshot.m_sensorOverlaps.end());
+	m_sensorEvents.clear();
+	m_stepStats.step = snapshot.m_step;
+	m_accumulator = snapshot.m_accumulator;
+	m_previousTransforms.clear();
+	InvalidateQueryTree();
+	if (m_isDeterministic)
+		m_stateHash = ComputeStateHash();
+	return true;
+}
+
+/*
+====================================================
+Scene::GetQueryTree
+====================================================
+*/
+const QueryTree& Scene::GetQueryTree() const {
+	assert(!m_isUpdating);
+
+	if (!m_isQueryTreeValid.load(std::memory_order_acquire)) {
+		std::lock_guard<std::mutex> lock(m_queryTreeMutex);
+		if (!m_isQueryTreeValid.load(std::memory_order_relaxed)) {
+			PROFILE_SCOPE("BuildQueryTree");
+			m_queryTree.Build(m_bodies.data(), static_cast<int>(m_bodies.size()));
+			m_isQueryTreeValid.store(true, std::memory_order_release);
+		}
+	}
+	return m_queryTree;
+}
+
+/*
+====================================================
+Scene::RayCast
+====================================================
+*/
+bool Scene::RayCast(const ray_t& ray, rayHit_t& hit) const {
+	if (0 == GetQueryTree().RayCast(ray, QueryTree::RAYCAST_CLOSEST, &hit, 1))
+		return false;
+	hit.body = m_bodyHandles.GetHandle(hit.bodyIndex);
+	return true;
+}
+
+/*
+====================================================
+Scene::RayCastAny
+====================================================
+*/
+bool Scene::RayCastAny(const ray_t& ray, rayHit_t& hit) const {
+	if (0 == GetQueryTree().RayCast(ray, QueryTree::RAYCAST_ANY, &hit, 1))
+		return false;
+	hit.body = m_bodyHandles.GetHandle(hit.bodyIndex);
+	return true;
+}
+
+/*
+====================================================
+Scene::RayCastAll
+====================================================
+*/
+int Scene::RayCastAll(const ray_t& ray, rayHit_t* hits, const int maxHits) const {
+	const int numHits = GetQueryTree().RayCast(ray, QueryTree::RAYCAST_ALL, hits, maxHits);
+	for (int i = 0; i < numHits; ++i)
+		hits[i].body = m_bodyHandles.GetHandle(hits[i].bodyIndex);
+	return numHits;
+}
+
+/*
+====================================================
+Scene::RayCastMany
+====================================================
+*/
+int Scene::RayCastMany(const ray_t* rays, const int numRays, rayHit_t* hits, const bool isAnyHit) const {
+	PROFILE_SCOPE("RayCastMany");
+	const QueryTree& queryTree = GetQueryTree();
+	const QueryTree::rayCastMode_t mode = isAnyHit ? QueryTree::RAYCAST_ANY : QueryTree::RAYCAST_CLOSEST;
+
+	// neighbouring rays of a batch tend to walk the same nodes, so batches stay on one worker
+	auto castRays = [this, &queryTree, rays, hits, mode](int begin, int end) {
+		for (int rayIndex = begin; rayIndex < end; ++rayIndex) {
+			rayHit_t& hit = hits[rayIndex];
+			if (0 == queryTree.RayCast(rays[rayIndex], mode, &hit, 1)) {
+				hit.body = INVALID_BODY_HANDLE;
+				hit.bodyIndex = -1;
+				continue;
+			}
+			hit.body = m_bodyHandles.GetHandle(hit.bodyIndex);
+		}
+	};
+	if (NULL != m_jobSystem)
+		m_jobSystem->ParallelFor(numRays, 64, castRays);
+	else
+		castRays(0, numRays);
+
+	int numHits = 0;
+	for (int rayIndex = 0; rayIndex < numRays; ++rayIndex) {
+		if (hits[rayIndex].bodyIndex >= 0)
+			numHits++;
+	}
+	return numHits;
+}
+
+/*
+====================================================
+Scene::OverlapSphere
+====================================================
+*/
+int Scene::OverlapSphere(const Vec3& center, const float radius, bodyHandle_t* bodies, const int maxBodies) const {
+	Bounds bounds;
+	bounds.Expand(center - Vec3(radius));
+	bounds.Expand(center + Vec3(radius));
+
+	int numBodies = 0;
+	auto visitor = [&](int bodyIndex, const Vec3& bodyCenter, float bodyRadius) {
+		const float radiusSum = radius + bodyRadius;
+		if ((bodyCenter - center).GetLengthSqr() <= radiusSum * radiusSum) {
+			if (numBodies < maxBodies)
+				bodies[numBodies] = m_bodyHandles.GetHandle(bodyIndex);
+			numBodies++;
+		}
+		return true;
+	};
+	const QueryTree& queryTree = GetQueryTree();
+	queryTree.ForEachInBounds(bounds, visitor);
+
+	const std::vector<QueryTree::heightfield_t>& heightfields = queryTree.GetHeightfields();
+	for (int i = 0; i < heightfields.size(); ++i) {
+		const QueryTree::heightfield_t& heightfield = heightfields[i];
+		Vec3 pointOnTerrain;
+		Vec3 normal;
+		float separation;
+		if (heightfield.shape->SphereContact(heightfield.inverseOrientation.RotatePoint(center - heightfield.position), radius, pointOnTerrain, normal, separation)) {
+			if (numBodies < maxBodies)
+				bodies[numBodies] = m_bodyHandles.GetHandle(heightfield.bodyIndex);
+			numBodies++;
+		}
+	}
+	return numBodies;
+}
+
+/*
+====================================================
+Scene::OverlapAABB
+====================================================
+*/
+int Scene::OverlapAABB(const Bounds& bounds, bodyHandle_t* bodies, const int maxBodies) const {
+	int numBodies = 0;
+	auto visitor = [&](int bodyIndex, const Vec3& bodyCenter, float bodyRadius) {
+		if (numBodies < maxBodies)
+			bodies[numBodies] = m_bodyHandles.GetHandle(bodyIndex);
+		numBodies++;
+		return true;
+	};
+	const QueryTree& queryTree = GetQueryTree();
+	queryTree.ForEachInBounds(bounds, visitor);
+
+	// the bounds are taken into the space of the terrain, a rotated terrain gets the bounds of the rotated bounds
+	const std::vector<QueryTree::heightfield_t>& heightfields = queryTree.GetHeightfields();
+	for (int i = 0; i < heightfields.size(); ++i) {
+		const QueryTree::heightfield_t& heightfield = heightfields[i];
+		Bounds localBounds;
+		for (int corner = 0; corner < 8; ++corner) {
+			const Vec3 point((corner & 1) ? bounds.maxs.x : bounds.mins.x, (corner & 2) ? bounds.maxs.y : bounds.mins.y, (corner & 4) ? bounds.maxs.z : bounds.mins.z);
+			localBounds.Expand(heightfield.inverseOrientation.RotatePoint(point - heightfield.position));
+		}
+		if (heightfield.shape->OverlapBounds(localBounds)) {
+			if (numBodies < maxBodies)
+				bodies[numBodies] = m_bodyHandles.GetHandle(heightfield.bodyIndex);
+			numBodies++;
 		}
 	}
+	return numBodies;
+}
+
+/*
+====================================================
+Scene::SweepSphere
+====================================================
+*/
+bool Scene::SweepSphere(const Vec3& center, const float radius, const Vec3& displacement, rayHit_t& hit) const {
+	// everything the sphere can touch is inside the bounds of its start and end
+	Bounds bounds;
+	bounds.Expand(center - Vec3(radius));
+	bounds.Expand(center + Vec3(radius));
+	bounds.Expand(center + displacement - Vec3(radius));
+	bounds.Expand(center + displacement + Vec3(radius));
+
+	const ShapeSphere sweptShape(radius);
+	hit.bodyIndex = -1;
+	hit.t = 2.0f;
+	auto visitor = [&](int bodyIndex, const Vec3& bodyCenter, float bodyRadius) {
+		// the body stands still over a time step of one, so the time of impact is the fraction of the displacement
+		const ShapeSphere bodyShape(bodyRadius);
+		Vec3 pointOnSwept;
+		Vec3 pointOnBody;
+		float timeOfImpact;
+		if (SphereSphereDynamic(&sweptShape, &bodyShape, center, bodyCenter, displacement, Vec3(0.0f), 1.0f, pointOnSwept, pointOnBody, timeOfImpact) && timeOfImpact < hit.t) {
+			hit.bodyIndex = bodyIndex;
+			hit.t = timeOfImpact;
+			hit.point = pointOnBody;
+			hit.normal = center + displacement * timeOfImpact - bodyCenter;
+			hit.normal.Normalize();
+		}
+		return true;
+	};
+	const QueryTree& queryTree = GetQueryTree();
+	queryTree.ForEachInBounds(bounds, visitor);
+
+	// marched in steps of the radius, long sweeps of small spheres over terrain cost more
+	const int maxTerrainSteps = 1024;
+	const std::vector<QueryTree::heightfield_t>& heightfields = queryTree.GetHeightfields();
+	for (int i = 0; i < heightfields.size(); ++i) {
+		const QueryTree::heightfield_t& heightfield = heightfields[i];
+		const Vec3 localCenter = heightfield.inverseOrientation.RotatePoint(center - heightfield.position);
+		const Vec3 localDisplacement = heightfield.inverseOrientation.RotatePoint(displacement);
+		float timeOfImpact;
+		Vec3 localPoint;
+		Vec3 localNormal;
+		float separation;
+		if (heightfield.shape->SweepSphere(localCenter, radius, localDisplacement, maxTerrainSteps, timeOfImpact, localPoint, localNormal, separation) && timeOfImpact < hit.t) {
+			hit.bodyIndex = heightfield.bodyIndex;
+			hit.t = timeOfImpact;
+			hit.point = heightfield.position + heightfield.orientation.RotatePoint(localPoint);
+			hit.normal = heightfield.orientation.RotatePoint(localNormal);
+		}
+	}
+
+	if (hit.bodyIndex < 0) {
+		hit.body = INVALID_BODY_HANDLE;
+		return false;
+	}
+	hit.body = m_bodyHandles.GetHandle(hit.bodyIndex);
+	return true;
 }
 
 /*
@@ -90,66 +645,682 @@ Scene::Update
 ====================================================
 */
 void Scene::Update(const float deltaSecond) {
-	// Gravity impulse
-	for (int currentBodyIndex = 0; currentBodyIndex < m_bodies.size(); ++currentBodyIndex) {
-		Body* currentBody = &m_bodies[currentBodyIndex];
+	Update(deltaSecond, m_ownScratch);
+}
+
+/*
+====================================================
+Scene::Update
+====================================================
+*/
+void Scene::Update(const float deltaSecond, stepScratch_t& scratch) {
+	m_sensorEvents.clear();
+	UpdateStep(deltaSecond, scratch);
+}
+
+/*
+====================================================
+Scene::UpdateStep
+====================================================
+*/
+void Scene::UpdateStep(const float deltaSecond, stepScratch_t& scratch) {
+	PROFILE_SCOPE("Update");
+	m_scratch = &scratch;
+	if (m_reorderInterval > 0 && m_stepStats.step > 0 && 0 == m_stepStats.step % m_reorderInterval)
+		ReorderBodies();
+	m_isUpdating = true;
+	InvalidateQueryTree();
 
-		float mass = 1.0f / currentBody->m_invMass;
-		Vec3 impulseGravity = Vec3(0, 0, -10) * mass * deltaSecond;
-		currentBody->ApplyImpulseLinear(impulseGravity);
+	if (NULL == m_jobSystem) {
+		ApplyGravity(deltaSecond);
+		UpdateBroadPhase(deltaSecond);
+		UpdateNarrowPhase(deltaSecond);
+		SortContacts();
+		ResolveContacts(deltaSecond);
+		UpdateSensors();
+		UpdateSleep();
+		UpdateStepStats();
+		if (m_isDeterministic)
+			m_stateHash = ComputeStateHash();
+		m_isUpdating = false;
+		m_scratch = &m_ownScratch;
+		if (NULL != m_replayRecorder)
+			m_replayRecorder->RecordFrame(*this);
+		return;
 	}
 
-	// Broadphase
-	std::vector<collisionPair_t> collisionPairs;
-	BroadPhase(m_bodies.data(), static_cast<int>(m_bodies.size()), collisionPairs, deltaSecond);
+	m_updateDeltaSecond = deltaSecond;
+	m_jobSystem->Run(*m_updateGraph);
+
+	UpdateStepStats();
+	if (m_isDeterministic)
+		m_stateHash = ComputeStateHash();
+	m_isUpdating = false;
+	m_scratch = &m_ownScratch;
+	if (NULL != m_replayRecorder)
+		m_replayRecorder->RecordFrame(*this);
+}
+
+/*
+====================================================
+Scene::ApplyGravity
+====================================================
+*/
+void Scene::ApplyGravity(const float deltaSecond) {
+	PROFILE_SCOPE("Gravity");
+
+	auto applyGravity = [this, deltaSecond](int begin, int end) {
+		for (int currentBodyIndex = begin; currentBodyIndex < end; ++currentBodyIndex) {
+			Body* currentBody = &m_bodies[currentBodyIndex];
+			if (currentBody->m_isSleeping)
+				continue;
 
-	// Narrowphase
-	int numContacts = 0;
-	const int maxContacts = m_bodies.size() * m_bodies.size();
-	contact_t* contacts = reinterpret_cast<contact_t*>(alloca(sizeof(contact_t) * maxContacts));
+			float mass = 1.0f / currentBody->m_invMass;
+			Vec3 impulseGravity = Vec3(0, 0, -10) * mass * deltaSecond;
+			currentBody->ApplyImpulseLinear(impulseGravity);
+		}
+	};
+
+	const int numBodies = static_cast<int>(m_bodies.size());
+	if (NULL != m_jobSystem)
+		m_jobSystem->ParallelFor(numBodies, 256, applyGravity);
+	else
+		applyGravity(0, numBodies);
+}
+
+/*
+====================================================
+Scene::ClassifyBodies
+====================================================
+*/
+void Scene::ClassifyBodies(const float deltaSecond) {
+	PROFILE_SCOPE("ClassifyBodies");
+
+	float motionFraction = m_ccdMotionFraction;
+	if (0 != (m_degradations & DEGRADE_FAST_CCD))
+		motionFraction = std::max(motionFraction, DEGRADED_CCD_MOTION_FRACTION);
+
+	auto classifyBodies = [this, deltaSecond, motionFraction](int begin, int end) {
+		for (int currentBodyIndex = begin; currentBodyIndex < end; ++currentBodyIndex) {
+			Body& body = m_bodies[currentBodyIndex];
+			if (body.m_isBullet || 0.0f == motionFraction) {
+				body.m_isSwept = true;
+				continue;
+			}
+			if (0.0f == body.m_invMass || body.m_isSleeping) {
+				body.m_isSwept = false;
+				continue;
+			}
+
+			// only the linear motion counts, the shapes are spheres so far
+			const Bounds bounds = body.m_shape->GetBounds();
+			const float halfSize = 0.5f * std::min(bounds.WidthX(), std::min(bounds.WidthY(), bounds.WidthZ()));
+			const float maxMotion = motionFraction * halfSize;
+			body.m_isSwept = (body.m_linearVelocity * deltaSecond).GetLengthSqr() >= maxMotion * maxMotion;
+		}
+	};
+
+	const int numBodies = static_cast<int>(m_bodies.size());
+	if (NULL != m_jobSystem)
+		m_jobSystem->ParallelFor(numBodies, 1024, classifyBodies);
+	else
+		classifyBodies(0, numBodies);
+}
+
+/*
+====================================================
+Scene::UpdateBroadPhase
+====================================================
+*/
+void Scene::UpdateBroadPhase(const float deltaSecond) {
+	ClassifyBodies(deltaSecond);
+
+	PROFILE_SCOPE("BroadPhase");
+	pairFilter_t filter;
+	filter.ignoredPairs = &m_ignoredPairs;
+	filter.bodySlots = m_bodyHandles.GetDenseToSlot();
+	BroadPhase(m_bodies.data(), static_cast<int>(m_bodies.size()), m_scratch->collisionPairs, deltaSecond, m_scratch->sortedBodies, m_jobSystem, &filter);
+}
+
+/*
+====================================================
+Scene::UpdateNarrowPhase
+====================================================
+*/
+void Scene::UpdateNarrowPhase(const float deltaSecond) {
+	PROFILE_SCOPE("NarrowPhase");
+	const int64_t startTime = GetTimeNanoseconds();
+
+	// every pair produces at most one contact
+	const int numPairs = static_cast<int>(m_scratch->collisionPairs.size());
+	m_scratch->contacts.resize(numPairs);
+	m_scratch->contactKeys.clear();
+	m_numContacts = 0;
+	m_scratch->sensorPairs.clear();
 
 	// check for collisions with other bodies
-	// now using collision pairs
-	for (int currentPairIndex = 0; currentPairIndex < collisionPairs.size(); ++currentPairIndex) {
-		const collisionPair_t& currentPair = collisionPairs[currentPairIndex];
-		Body* bodyA = &m_bodies[currentPair.a];
-		Body* bodyB = &m_bodies[currentPair.b];
-
-		// skip body pairs with infinite mass
-		if (0.0f == bodyA->m_invMass && 0.0f == bodyB->m_invMass)
-			continue;
+	// now using collision pairs, the pairs with a sensor skip the TOI test and are only checked for overlap after the bodies moved
+	if (NULL == m_jobSystem) {
+		for (int currentPairIndex = 0; currentPairIndex < numPairs; ++currentPairIndex) {
+			const collisionPair_t& currentPair = m_scratch->collisionPairs[currentPairIndex];
+			Body* bodyA = &m_bodies[currentPair.a];
+			Body* bodyB = &m_bodies[currentPair.b];
+
+			contact_t& contact = m_scratch->contacts[m_numContacts];
+			const int result = TestPair(bodyA, bodyB, deltaSecond, contact);
+			if (2 == result) {
+				m_scratch->sensorPairs.push_back(currentPair);
+			} else if (1 == result) {
+				m_scratch->contactKeys.push_back(MakeContactKey(contact.timeOfImpact, m_numContacts));
+				++m_numContacts;
+			}
+		}
+		m_stepStats.narrowPhaseMilliseconds = float(double(GetTimeNanoseconds() - startTime) * 1.0e-6);
+		return;
+	}
+
+	// each pair writes to its own slot, the keys of the found contacts are gathered afterwards in pair order
+	m_scratch->isContactFound.resize(numPairs);
+	m_jobSystem->ParallelFor(numPairs, 64, [this, deltaSecond](int begin, int end) {
+		for (int currentPairIndex = begin; currentPairIndex < end; ++currentPairIndex) {
+			const collisionPair_t& currentPair = m_scratch->collisionPairs[currentPairIndex];
+			Body* bodyA = &m_bodies[currentPair.a];
+			Body* bodyB = &m_bodies[currentPair.b];
+			m_scratch->isContactFound[currentPairIndex] = static_cast<char>(TestPair(bodyA, bodyB, deltaSecond, m_scratch->contacts[currentPairIndex]));
+		}
+	});
 
-		contact_t contact;
-		if (Intersect(bodyA, bodyB, deltaSecond, contact)) {
-			contacts[numContacts] = contact;
-			++numContacts;
+	for (int currentPairIndex = 0; currentPairIndex < numPairs; ++currentPairIndex) {
+		if (0 == m_scratch->isContactFound[currentPairIndex])
+			continue;
+		if (2 == m_scratch->isContactFound[currentPairIndex]) {
+			m_scratch->sensorPairs.push_back(m_scratch->collisionPairs[currentPairIndex]);
+			continue;
 		}
+		m_scratch->contactKeys.push_back(MakeContactKey(m_scratch->contacts[currentPairIndex].timeOfImpact, currentPairIndex));
+		++m_numContacts;
 	}
+	m_stepStats.narrowPhaseMilliseconds = float(double(GetTimeNanoseconds() - startTime) * 1.0e-6);
+}
+
+/*
+====================================================
+Scene::TestPair
+// 0 no contact, 1 contact, 2 sensor pair
+====================================================
+*/
+int Scene::TestPair(Body* bodyA, Body* bodyB, const float deltaSecond, contact_t& contact) const {
+	if (bodyA->m_isSensor || bodyB->m_isSensor)
+		return 2;
+
+	// nothing moves unless one of the bodies is awake and dynamic
+	const bool isMovingA = !bodyA->m_isSleeping && bodyA->m_invMass > 0.0f;
+	const bool isMovingB = !bodyB->m_isSleeping && bodyB->m_invMass > 0.0f;
+	if (!isMovingA && !isMovingB)
+		return 0;
+
+	// two slow bodies can't pass through each other within a step, the discrete test catches them a step late at most
+	if (bodyA->m_isSwept || bodyB->m_isSwept)
+		return Intersect(bodyA, bodyB, deltaSecond, contact, m_bodyIntegration) ? 1 : 0;
+	return Intersect(bodyA, bodyB, contact) ? 1 : 0;
+}
+
+/*
+====================================================
+Scene::SortContacts
+====================================================
+*/
+void Scene::SortContacts() {
+	PROFILE_SCOPE("SortContacts");
+
+	// sort TOI from earliest to latest, only the keys move
+	// the keys are unique and equal TOIs keep pair order, so this is deterministic as well
+	std::sort(m_scratch->contactKeys.begin(), m_scratch->contactKeys.end());
+}
 
-	// sort TOI from earliest to latest
-	if (numContacts > 1)
-		qsort(contacts, numContacts, sizeof(contact_t), CompareContacts);
+/*
+====================================================
+Scene::ResolveContacts
+====================================================
+*/
+void Scene::ResolveContacts(const float deltaSecond) {
+	PROFILE_SCOPE("ResolveContacts");
 
 	// resolve collisions
 	// note that there’s no recalculation of earlier collisions for later ones to improve performance.
 	// thus, while the first collision is handled correctly, later collisions may be processed improperly if they are related to the earlier collisions.
+	// under a time budget the bodies only advance once per slot, the contacts in between are resolved together
+	const float slotSecond = (0 != (m_degradations & DEGRADE_TOI_SLOTS)) ? deltaSecond / float(NUM_TOI_SLOTS) : 0.0f;
 	float accumulatedTime = 0.0f;
-	for (int currentContactIndex = 0; currentContactIndex < numContacts; ++currentContactIndex) {
-		contact_t& contact = contacts[currentContactIndex];
-		const float deltaTime = contact.timeOfImpact - accumulatedTime;
+	m_stepStats.numToiEvents = 0;
+	m_stepStats.maxPenetration = 0.0f;
+	for (int currentContactIndex = 0; currentContactIndex < m_numContacts; ++currentContactIndex) {
+		contact_t& contact = m_scratch->contacts[GetContactIndex(m_scratch->contactKeys[currentContactIndex])];
+		float deltaTime = contact.timeOfImpact - accumulatedTime;
+		if (deltaTime < slotSecond)
+			deltaTime = 0.0f;
+
+		if (contact.timeOfImpact > 0.0f)
+			++m_stepStats.numToiEvents;
+		if (-contact.separationDistance > m_stepStats.maxPenetration)
+			m_stepStats.maxPenetration = -contact.separationDistance;
 
-		// position update
-		for (int currentBodyIndex = 0; currentBodyIndex < m_bodies.size(); ++currentBodyIndex)
-			m_bodies[currentBodyIndex].Update(deltaTime);
+		// position update, the contacts at the same time (most of them at time zero) share one
+		if (deltaTime > 0.0f)
+			UpdateBodies(deltaTime);
 
+		// something that was moving wakes a sleeping body up, otherwise the sleeping body holds still like a static one
+		Body& bodyA = *contact.bodyA;
+		Body& bodyB = *contact.bodyB;
+		if (bodyA.m_isSleeping && !bodyB.m_isSleeping && bodyB.m_numRestingSteps <= 1)
+			WakeBody(bodyA);
+		if (bodyB.m_isSleeping && !bodyA.m_isSleeping && bodyA.m_numRestingSteps <= 1)
+			WakeBody(bodyB);
+		const float invMassA = bodyA.m_invMass;
+		const float invMassB = bodyB.m_invMass;
+		if (bodyA.m_isSleeping)
+			bodyA.m_invMass = 0.0f;
+		if (bodyB.m_isSleeping)
+			bodyB.m_invMass = 0.0f;
 		ResolveContact(contact);
+		bodyA.m_invMass = invMassA;
+		bodyB.m_invMass = invMassB;
 		accumulatedTime += deltaTime;
 	}
 
 	// update the positions for the rest of this frame's time
 	const float timeRemaining = deltaSecond - accumulatedTime;
-	if (timeRemaining > 0.0f) {
-		for (int currentBodyIndex = 0; currentBodyIndex < m_bodies.size(); ++currentBodyIndex)
-			m_bodies[currentBodyIndex].Update(timeRemaining);
+	if (timeRemaining > 0.0f)
+		UpdateBodies(timeRemaining);
+}
+
+/*
+====================================================
+Scene::UpdateSensors
+====================================================
+*/
+void Scene::UpdateSensors() {
+	PROFILE_SCOPE("Sensors");
+
+	if (m_scratch->sensorPairs.empty() && m_sensorOverlaps.empty())
+		return;
+
+	// the broadphase bounds cover the whole step of the swept bodies, the others move too little to matter before the next step
+	m_previousSensorOverlaps.swap(m_sensorOverlaps);
+	m_sensorOverlaps.clear();
+	for (const collisionPair_t& pair : m_scratch->sensorPairs) {
+		const bool isSensorA = m_bodies[pair.a].m_isSensor;
+		const int sensorIndex = isSensorA ? pair.a : pair.b;
+		const int otherIndex = isSensorA ? pair.b : pair.a;
+		if (!SensorOverlap(m_bodies[sensorIndex], m_bodies[otherIndex]))
+			continue;
+
+		sensorOverlap_t overlap;
+		overlap.sensor = m_bodyHandles.GetHandle(sensorIndex);
+		overlap.other = m_bodyHandles.GetHandle(otherIndex);
+		m_sensorOverlaps.push_back(overlap);
 	}
+	SortSensorOverlaps(m_sensorOverlaps);
+
+	// appended to the events of the earlier steps of this Step call, the step count goes up at the end of the step
+	const size_t firstEvent = m_sensorEvents.size();
+	DiffSensorOverlaps(m_previousSensorOverlaps, m_sensorOverlaps, m_sensorEvents);
+	for (size_t eventIndex = firstEvent; eventIndex < m_sensorEvents.size(); ++eventIndex)
+		m_sensorEvents[eventIndex].step = m_stepStats.step + 1;
+}
+
+/*
+====================================================
+Scene::UpdateSleep
+====================================================
+*/
+void Scene::UpdateSleep() {
+	if (0 == (m_degradations & DEGRADE_SLEEP))
+		return;
+	PROFILE_SCOPE("Sleep");
+
+	// resting contacts leave some velocity behind and stacks jitter a little,
+	// so a body counts as resting when it stays within a tenth of its size for a while
+	const int numStepsToSleep = 30;
+	auto updateSleep = [this, numStepsToSleep](int begin, int end) {
+		for (int currentBodyIndex = begin; currentBodyIndex < end; ++currentBodyIndex) {
+			Body& body = m_bodies[currentBodyIndex];
+			if (body.m_isSleeping || 0.0f == body.m_invMass)
+				continue;
+
+			const Bounds bounds = body.m_shape->GetBounds();
+			const float restDistance = 0.1f * std::min(bounds.WidthX(), std::min(bounds.WidthY(), bounds.WidthZ()));
+			if (0 == body.m_numRestingSteps || (body.m_position - body.m_restPosition).GetLengthSqr() > restDistance * restDistance) {
+				body.m_restPosition = body.m_position;
+				body.m_numRestingSteps = 1;
+				continue;
+			}
+			if (++body.m_numRestingSteps >= numStepsToSleep) {
+				body.m_isSleeping = true;
+				body.m_linearVelocity.Zero();
+				body.m_angularVelocity.Zero();
+			}
+		}
+	};
+
+	const int numBodies = static_cast<int>(m_bodies.size());
+	if (NULL != m_jobSystem)
+		m_jobSystem->ParallelFor(numBodies, 1024, updateSleep);
+	else
+		updateSleep(0, numBodies);
+}
+
+/*
+====================================================
+Scene::WakeBodies
+====================================================
+*/
+void Scene::WakeBodies() {
+	for (Body& body : m_bodies)
+		WakeBody(body);
+}
+
+/*
+====================================================
+Scene::UpdateBodies
+====================================================
+*/
+void Scene::UpdateBodies(const float deltaSecond) {
+	auto updateBodies = [this, deltaSecond](int begin, int end) {
+		for (int currentBodyIndex = begin; currentBodyIndex < end; ++currentBodyIndex) {
+			if (!m_bodies[currentBodyIndex].m_isSleeping)
+				m_bodies[currentBodyIndex].Update(deltaSecond, m_bodyIntegration);
+		}
+	};
+
+	const int numBodies = static_cast<int>(m_bodies.size());
+	if (NULL != m_jobSystem)
+		m_jobSystem->ParallelFor(numBodies, 256, updateBodies);
+	else
+		updateBodies(0, numBodies);
+}
+
+/*
+====================================================
+Scene::UpdateStepStats
+====================================================
+*/
+void Scene::UpdateStepStats() {
+	const int numBodies = static_cast<int>(m_bodies.size());
+	const float restingSpeedSqr = 0.01f * 0.01f;
+	auto countAwake = [this, restingSpeedSqr](int begin, int end) {
+		int numAwake = 0;
+		for (int currentBodyIndex = begin; currentBodyIndex < end; ++currentBodyIndex) {
+			const Body& body = m_bodies[currentBodyIndex];
+			if (0.0f == body.m_invMass)
+				continue;
+			if (body.m_linearVelocity.GetLengthSqr() > restingSpeedSqr || body.m_angularVelocity.GetLengthSqr() > restingSpeedSqr)
+				++numAwake;
+		}
+		return numAwake;
+	};
+
+	m_stepStats.step++;
+	m_stepStats.numBodies = numBodies;
+	m_stepStats.reorderMilliseconds = m_reorderMilliseconds;
+	m_stepStats.degradations = m_degradations;
+	m_reorderMilliseconds = 0.0f;
+	m_stepStats.numAwakeBodies = ParallelReduce(m_jobSystem, numBodies, 4096, 0, countAwake, [](int a, int b) { return a + b; });
+	m_stepStats.numCollisionPairs = static_cast<int>(m_scratch->collisionPairs.size());
+	m_stepStats.numContacts = m_numContacts;
+	m_stepStats.pairEfficiency = (m_scratch->collisionPairs.empty()) ? 0.0f : float(m_numContacts) / float(m_scratch->collisionPairs.size());
+	m_stepStats.scratchBytesUsed = static_cast<int64_t>(
+		m_scratch->sortedBodies.size() * sizeof(psuedoBody_t) +
+		m_scratch->collisionPairs.size() * sizeof(collisionPair_t) +
+		m_scratch->contacts.size() * sizeof(contact_t) +
+		m_scratch->contactKeys.size() * sizeof(contactKey_t) +
+		m_scratch->sensorPairs.size() * sizeof(collisionPair_t) +
+		((NULL != m_jobSystem) ? m_scratch->isContactFound.size() * sizeof(char) : 0));
+
+	if (NULL != m_stepStatsWriter)
+		m_stepStatsWriter->Write(m_stepStats);
+}
+
+/*
+====================================================
+Scene::GetScratchBytes
+====================================================
+*/
+size_t Scene::GetScratchBytes() const {
+	return m_ownScratch.GetNumBytes();
+}
+
+/*
+====================================================
+Scene::GetNumThreads
+====================================================
+*/
+int Scene::GetNumThreads() const {
+	return (NULL != m_jobSystem) ? m_jobSystem->GetNumThreads() : 1;
+}
+
+/*
+====================================================
+stepScratch_t::GetNumBytes
+====================================================
+*/
+size_t stepScratch_t::GetNumBytes() const {
+	size_t numBytes = 0;
+	numBytes += sortedBodies.capacity() * sizeof(psuedoBody_t);
+	numBytes += collisionPairs.capacity() * sizeof(collisionPair_t);
+	numBytes += contacts.capacity() * sizeof(contact_t);
+	numBytes += contactKeys.capacity() * sizeof(contactKey_t);
+	numBytes += isContactFound.capacity() * sizeof(char);
+	numBytes += sensorPairs.capacity() * sizeof(collisionPair_t);
+	numBytes += mortonKeys.capacity() * sizeof(uint64_t);
+	numBytes += newToOld.capacity() * sizeof(int);
+	numBytes += reorderedBodies.capacity() * sizeof(Body);
+	numBytes += reorderedTransforms.capacity() * sizeof(bodyTransform_t);
+	return numBytes;
+}
+
+/*
+====================================================
+Scene::SetFixedTimeStep
+====================================================
+*/
+void Scene::SetFixedTimeStep(const float fixedDeltaSecond, const int maxStepsPerFrame) {
+	m_fixedDeltaSecond = fixedDeltaSecond;
+	m_maxStepsPerFrame = (maxStepsPerFrame < 1) ? 1 : maxStepsPerFrame;
+	m_accumulator = 0.0f;
+}
+
+/*
+====================================================
+Scene::Step
+====================================================
+*/
+int Scene::Step(const float wallDeltaSecond) {
+	m_accumulator += wallDeltaSecond;
+
+	// drop the time we can't catch up on, otherwise a slow frame makes the next one even slower
+	const float maxAccumulated = m_fixedDeltaSecond * float(m_maxStepsPerFrame);
+	if (m_accumulator > maxAccumulated)
+		m_accumulator = maxAccumulated;
+
+	const int numSteps = static_cast<int>(m_accumulator / m_fixedDeltaSecond);
+	RunFixedSteps(numSteps);
+	return numSteps;
+}
+
+/*
+====================================================
+Scene::StepWithBudget
+====================================================
+*/
+int Scene::StepWithBudget(const float wallDeltaSecond, const float budgetSecond) {
+	const int64_t startTime = GetTimeNanoseconds();
+	m_accumulator += wallDeltaSecond;
+
+	const float maxAccumulated = m_fixedDeltaSecond * float(m_maxStepsPerFrame);
+	if (m_accumulator > maxAccumulated)
+		m_accumulator = maxAccumulated;
+
+	// the level covers the quality of each step, dropping catch-up steps is decided per call on top of it
+	m_degradations = 0;
+	if (m_degradationLevel >= 1)
+		m_degradations |= DEGRADE_TOI_SLOTS;
+	if (m_degradationLevel >= 2)
+		m_degradations |= DEGRADE_FAST_CCD;
+	if (m_degradationLevel >= 3)
+		m_degradations |= DEGRADE_SLEEP;
+
+	// run only as many steps as the recent step cost says fit, the dropped time is lost rather than caught up on later
+	int numSteps = static_cast<int>(m_accumulator / m_fixedDeltaSecond);
+	if (numSteps > 1 && m_averageUpdateSecond > 0.0) {
+		const int numAffordable = std::max(1, static_cast<int>(double(budgetSecond) / m_averageUpdateSecond));
+		if (numAffordable < numSteps) {
+			m_accumulator -= float(numSteps - numAffordable) * m_fixedDeltaSecond;
+			numSteps = numAffordable;
+			m_degradations |= DEGRADE_STEPS;
+		}
+	}
+	RunFixedSteps(numSteps);
+	// the bits only apply to this call's steps, a plain Step or Update afterwards runs at full quality
+	m_degradations = 0;
+
+	// degrade right away when over the budget, but only recover after a while so the quality doesn't flicker
+	const double elapsedSecond = double(GetTimeNanoseconds() - startTime) * 1.0e-9;
+	if (elapsedSecond > double(budgetSecond)) {
+		m_degradationLevel = std::min(m_degradationLevel + 1, MAX_DEGRADATION_LEVEL);
+		m_numCalmSteps = 0;
+	} else if (elapsedSecond < 0.5 * double(budgetSecond) && m_degradationLevel > 0) {
+		if (++m_numCalmSteps >= 60) {
+			if (m_degradationLevel >= 3)
+				WakeBodies();
+			m_degradationLevel--;
+			m_numCalmSteps = 0;
+		}
+	} else {
+		m_numCalmSteps = 0;
+	}
+	return numSteps;
+}
+
+/*
+====================================================
+Scene::ClearDegradation
+====================================================
+*/
+void Scene::ClearDegradation() {
+	assert(!m_isUpdating);
+	WakeBodies();
+	m_degradationLevel = 0;
+	m_numCalmSteps = 0;
+}
+
+/*
+====================================================
+Scene::RunFixedSteps
+====================================================
+*/
+void Scene::RunFixedSteps(const int numSteps) {
+	// the events of all the steps are kept until the next call
+	m_sensorEvents.clear();
+	for (int currentStep = 0; currentStep < numSteps; ++currentStep) {
+		// only the state before the last step is needed for the interpolation
+		if (currentStep == numSteps - 1)
+			StorePreviousTransforms();
+
+		const int64_t startTime = GetTimeNanoseconds();
+		UpdateStep(m_fixedDeltaSecond, m_ownScratch);
+		m_accumulator -= m_fixedDeltaSecond;
+
+		const double updateSecond = double(GetTimeNanoseconds() - startTime) * 1.0e-9;
+		m_averageUpdateSecond = (m_averageUpdateSecond > 0.0) ? (0.8 * m_averageUpdateSecond + 0.2 * updateSecond) : updateSecond;
+	}
+
+	if (m_accumulator < 0.0f)
+		m_accumulator = 0.0f;
+	m_interpolationAlpha = m_accumulator / m_fixedDeltaSecond;
+}
+
+/*
+====================================================
+Scene::StorePreviousTransforms
+====================================================
+*/
+void Scene::StorePreviousTransforms() {
+	m_previousTransforms.resize(m_bodies.size());
+	for (int currentBodyIndex = 0; currentBodyIndex < m_bodies.size(); ++currentBodyIndex) {
+		m_previousTransforms[currentBodyIndex].position = m_bodies[currentBodyIndex].m_position;
+		m_previousTransforms[currentBodyIndex].orientation = m_bodies[currentBodyIndex].m_orientation;
+	}
+}
+
+/*
+====================================================
+Scene::GetInterpolatedTransform
+====================================================
+*/
+void Scene::GetInterpolatedTransform(const int bodyIndex, Vec3& position, Quat& orientation) const {
+	const Body& body = m_bodies[bodyIndex];
+	if (bodyIndex >= m_previousTransforms.size()) {
+		position = body.m_position;
+		orientation = body.m_orientation;
+		return;
+	}
+
+	const bodyTransform_t& previous = m_previousTransforms[bodyIndex];
+	const float alpha = m_interpolationAlpha;
+	position = previous.position + (body.m_position - previous.position) * alpha;
+
+	// nlerp along the shortest arc, which is close enough to slerp for a single step of rotation
+	const Quat& from = previous.orientation;
+	Quat to = body.m_orientation;
+	if (from.x * to.x + from.y * to.y + from.z * to.z + from.w * to.w < 0.0f)
+		to = Quat(-to.x, -to.y, -to.z, -to.w);
+
+	orientation.x = from.x + (to.x - from.x) * alpha;
+	orientation.y = from.y + (to.y - from.y) * alpha;
+	orientation.z = from.z + (to.z - from.z) * alpha;
+	orientation.w = from.w + (to.w - from.w) * alpha;
+	orientation.Normalize();
+}
+
+/*
+====================================================
+HashBytes
+// 64 bit FNV-1a
+====================================================
+*/
+static uint64_t HashBytes(uint64_t hash, const void* data, const int numBytes) {
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+	for (int i = 0; i < numBytes; ++i) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/*
+====================================================
+Scene::ComputeStateHash
+====================================================
+*/
+uint64_t Scene::ComputeStateHash() const {
+	const uint64_t offsetBasis = 14695981039346656037ULL;
+
+	// hash the raw bits of the dynamic state, batches are hashed separately and folded together in order
+	auto hashBodies = [this, offsetBasis](int begin, int end) {
+		uint64_t hash = offsetBasis;
+		for (int currentBodyIndex = begin; currentBodyIndex < end; ++currentBodyIndex) {
+			const Body& body = m_bodies[currentBodyIndex];
+			hash = HashBytes(hash, &body.m_position, sizeof(body.m_position));
+			hash = HashBytes(hash, &body.m_orientation, sizeof(body.m_orientation));
+			hash = HashBytes(hash, &body.m_linearVelocity, sizeof(body.m_linearVelocity));
+			hash = HashBytes(hash, &body.m_angularVelocity, sizeof(body.m_angularVelocity));
+		}
+		return hash;
+	};
+	auto combineHashes = [](uint64_t hash, uint64_t batchHash) {
+		return HashBytes(hash, &batchHash, sizeof(batchHash));
+	};
+
+	return ParallelReduce(m_jobSystem, static_cast<int>(m_bodies.size()), 1024, offsetBasis, hashBodies, combineHashes);
 }
@@ -0,0 +1,223 @@
+//
+//  Scene.h
+//
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+#include "Physics/Shapes.h"
+#include "Physics/Body.h"
+#include "Physics/BodyHandles.h"
+#include "Physics/Broadphase.h"
+#include "Physics/Contact.h"
+#include "Physics/QueryTree.h"
+#include "Physics/SensorEvents.h"
+#include "Physics/ShapeLibrary.h"
+#include "Profiler/StepStats.h"
+#include "SceneSnapshot.h"
+
+class JobSystem;
+class TaskGraph;
+class ReplayRecorder;
+
+/*
+====================================================
+bodyTransform_t
+====================================================
+*/
+struct bodyTransform_t {
+	Vec3 position;
+	Quat orientation;
+};
+
+/*
+====================================================
+stepScratch_t
+// Buffers that only live for the duration of a step, kept around to avoid
+// reallocating every step. A scene has its own, SceneBatch lends the scenes
+// the one of the worker stepping them instead.
+====================================================
+*/
+struct stepScratch_t {
+	std::vector< psuedoBody_t > sortedBodies;
+	std::vector< collisionPair_t > collisionPairs;
+	std::vector< contact_t > contacts;	// cold, indexed by the keys
+	std::vector< contactKey_t > contactKeys;	// hot, sorted and walked by the resolve
+	std::vector< char > isContactFound;
+	std::vector< collisionPair_t > sensorPairs;
+
+	// ReorderBodies
+	std::vector< uint64_t > mortonKeys;
+	std::vector< int > newToOld;
+	std::vector< Body > reorderedBodies;
+	std::vector< bodyTransform_t > reorderedTransforms;
+
+	size_t GetNumBytes() const;	// reserved capacity, not what the last step used
+};
+
+/*
+====================================================
+Scene
+====================================================
+*/
+class Scene {
+public:
+	explicit Scene( const int numThreads = 1 );
+	~Scene();
+
+	void Reset();
+	void Initialize();
+	void Update( const float deltaSecond );
+	void Update( const float deltaSecond, stepScratch_t & scratch );	// steps with borrowed scratch buffers
+
+	// Consumes wall clock time in fixed size steps, returns the number of steps that were run
+	int Step( const float wallDeltaSecond );
+	void SetFixedTimeStep( const float fixedDeltaSecond, const int maxStepsPerFrame );
+
+	// Like Step, but gives up quality instead of going over the wall time budget, in this order: fewer
+	// catch-up steps, contacts resolved in coarse time slots, fewer bodies with swept tests and resting
+	// bodies put to sleep. The quality comes back once the steps fit into the budget again.
+	enum degradation_t {
+		DEGRADE_STEPS		= 1 << 0,	// dropped catch-up steps, the scene falls behind real time
+		DEGRADE_TOI_SLOTS	= 1 << 1,	// contacts within a slot of the step are resolved at the same time
+		DEGRADE_FAST_CCD	= 1 << 2,	// a larger CCD motion fraction, only the fastest bodies get swept tests
+		DEGRADE_SLEEP		= 1 << 3,	// resting bodies are frozen until something hits them
+	};
+	int StepWithBudget( const float wallDeltaSecond, const float budgetSecond );
+	int GetDegradations() const { return m_stepStats.degradations; }	// degradation_t bits of the last step
+	void ClearDegradation();	// back to full quality with every body awake, for going back to Step
+	float GetFixedDeltaSecond() const { return m_fixedDeltaSecond; }
+	float GetInterpolationAlpha() const { return m_interpolationAlpha; }
+	void GetInterpolatedTransform( const int bodyIndex, Vec3 & position, Quat & orientation ) const;
+	void SetBodyIntegration( const bodyIntegration_t & integration ) { m_bodyIntegration = integration; }
+	// Bodies moving less than this fraction of their half size in a step skip the swept test, bullets never do. 0 sweeps every body
+	void SetCcdMotionFraction( const float fraction ) { m_ccdMotionFraction = fraction; }
+	const bodyIntegration_t & GetBodyIntegration() const { return m_bodyIntegration; }
+
+	// Deterministic mode gives bitwise identical results for any thread count and sort implementation
+	void SetDeterministic( const bool isDeterministic ) { m_isDeterministic = isDeterministic; }
+	bool IsDeterministic() const { return m_isDeterministic; }
+	uint64_t ComputeStateHash() const;
+	uint64_t GetStateHash() const { return m_stateHash; }	// hash after the last Update in deterministic mode
+
+	// Bodies can be added and removed between steps, removing moves the last body into the hole
+	bodyHandle_t AddBody( const Body & body );
+	bool RemoveBody( const bodyHandle_t handle );
+	void ReserveBodies( const int numBodies );	// avoids regrowing while loading large scenes
+	bool IsValid( const bodyHandle_t handle ) const { return m_bodyHandles.IsValid( handle ); }
+	Body * GetBody( const bodyHandle_t handle );
+	bodyHandle_t GetBodyHandle( const int bodyIndex ) const { return m_bodyHandles.GetHandle( bodyIndex ); }
+	int GetBodyIndex( const bodyHandle_t handle ) const { return m_bodyHandles.GetDenseIndex( handle ); }
+
+	// On top of the group and mask bits of the bodies, for example a projectile and its owner
+	bool SetIgnoreCollision( const bodyHandle_t handleA, const bodyHandle_t handleB, const bool isIgnored );
+
+	// Overlaps of sensor bodies with the other bodies, every overlap gets an enter, stay or exit event once per step.
+	// Holds the events of all steps of the last Update, Step or StepWithBudget call, sorted by step and then by
+	// sensor, a call that ran no steps leaves it empty.
+	const std::vector< sensorEvent_t > & GetSensorEvents() const { return m_sensorEvents; }
+
+	// Sorts the dense body array by the Morton code of the positions so bodies close in space are close in
+	// memory, handles stay valid but body indices change. With an interval Update reorders every that many steps.
+	void ReorderBodies();
+	void SetReorderInterval( const int numSteps ) { m_reorderInterval = numSteps; }	// 0 never reorders
+
+	// Rollback support, only the dynamic state is copied. Restoring needs the same bodies as when the
+	// snapshot was saved, bodies added or removed since then have to be undone first.
+	void SaveState( SceneSnapshot & snapshot ) const;
+	bool RestoreState( const SceneSnapshot & snapshot );
+
+	// Queries see the scene as it was after the last Update and are safe to run from several threads
+	// between steps. RayCastMany spreads the rays over the job system, so it belongs on the stepping thread.
+	bool RayCast( const ray_t & ray, rayHit_t & hit ) const;		// closest hit
+	bool RayCastAny( const ray_t & ray, rayHit_t & hit ) const;		// first hit found, cheapest for line of sight
+	int RayCastAll( const ray_t & ray, rayHit_t * hits, const int maxHits ) const;
+	int RayCastMany( const ray_t * rays, const int numRays, rayHit_t * hits, const bool isAnyHit = false ) const;	// misses get INVALID_BODY_HANDLE, returns the number of hits
+
+	// The overlaps return how many bodies were found, only the first maxBodies of them are written
+	int OverlapSphere( const Vec3 & center, const float radius, bodyHandle_t * bodies, const int maxBodies ) const;
+	int OverlapAABB( const Bounds & bounds, bodyHandle_t * bodies, const int maxBodies ) const;
+	// First body a sphere moving by displacement touches, hit.t is the fraction of the displacement
+	bool SweepSphere( const Vec3 & center, const float radius, const Vec3 & displacement, rayHit_t & hit ) const;
+
+	const stepStats_t & GetStepStats() const { return m_stepStats; }	// counters of the last Update
+	void SetStepStatsWriter( StepStatsWriter * writer ) { m_stepStatsWriter = writer; }	// NULL stops streaming
+	void SetReplayRecorder( ReplayRecorder * recorder ) { m_replayRecorder = recorder; }	// records the transforms after every Update
+	size_t GetScratchBytes() const;	// memory reserved by the scene's own per step scratch buffers
+	int GetNumThreads() const;
+
+	std::vector< Body > m_bodies;	// dense, use handles to keep track of a body across removals
+	ShapeLibrary m_shapes;	// owns the shapes of m_bodies
+
+private:
+	void StorePreviousTransforms();
+	void RunFixedSteps( const int numSteps );
+	void BuildUpdateGraph();
+	void UpdateStep( const float deltaSecond, stepScratch_t & scratch );	// Update without clearing the sensor events
+	void WakeBodies();
+	static void WakeBody( Body & body ) { body.m_isSleeping = false; body.m_numRestingSteps = 0; }
+	int TestPair( Body * bodyA, Body * bodyB, const float deltaSecond, contact_t & contact ) const;
+	const QueryTree & GetQueryTree() const;
+	void InvalidateQueryTree() { m_isQueryTreeValid.store( false, std::memory_order_relaxed ); }
+
+	// stages of Update
+	void ApplyGravity( const float deltaSecond );
+	void ClassifyBodies( const float deltaSecond );
+	void UpdateBroadPhase( const float deltaSecond );
+	void UpdateNarrowPhase( const float deltaSecond );
+	void SortContacts();
+	void ResolveContacts( const float deltaSecond );
+	void UpdateSensors();
+	void UpdateSleep();
+	void UpdateBodies( const float deltaSecond );
+	void UpdateStepStats();
+
+	BodyHandleTable m_bodyHandles;
+	IgnoredPairs m_ignoredPairs;
+	bool m_isUpdating;
+
+	JobSystem * m_jobSystem;	// NULL when running on a single thread
+	TaskGraph * m_updateGraph;	// the stages of Update, built once along with the job system
+	float m_updateDeltaSecond;	// of the step the graph is running
+	bool m_isDeterministic;
+	uint64_t m_stateHash;
+	stepStats_t m_stepStats;
+	StepStatsWriter * m_stepStatsWriter;
+	ReplayRecorder * m_replayRecorder;
+
+	stepScratch_t m_ownScratch;
+	stepScratch_t * m_scratch;	// m_ownScratch unless an Update borrowed one
+	int m_numContacts;
+
+	// the overlaps of the last two steps, sorted so they can be diffed into events
+	std::vector< sensorOverlap_t > m_sensorOverlaps;
+	std::vector< sensorOverlap_t > m_previousSensorOverlaps;
+	std::vector< sensorEvent_t > m_sensorEvents;
+
+	int m_reorderInterval;
+	float m_reorderMilliseconds;	// reorders since the last step, goes into the stats of the next one
+
+	bodyIntegration_t m_bodyIntegration;
+	float m_ccdMotionFraction;
+	// rebuilt by the first query after the bodies changed
+	mutable QueryTree m_queryTree;
+	mutable std::mutex m_queryTreeMutex;
+	mutable std::atomic< bool > m_isQueryTreeValid;
+
+	float m_fixedDeltaSecond;
+	int m_maxStepsPerFrame;	// caps the catch-up work so a slow frame can't snowball (spiral of death)
+	float m_accumulator;
+	float m_interpolationAlpha;	// [0,1] blend factor from the previous step to the current one
+	std::vector< bodyTransform_t > m_previousTransforms;
+
+	// StepWithBudget
+	static const int NUM_TOI_SLOTS = 8;
+	static constexpr float DEGRADED_CCD_MOTION_FRACTION = 0.5f;
+	static const int MAX_DEGRADATION_LEVEL = 3;
+	int m_degradationLevel;	// how many of the degradations after the dropped steps are on
+	int m_degradations;
+	int m_numCalmSteps;		// StepWithBudget calls in a row well within the budget
+	double m_averageUpdateSecond;
+};
@@ -0,0 +1,145 @@
+//
+//  SceneBatch.cpp
+//
+#include "SceneBatch.h"
+#include "Threading/JobSystem.h"
+#include "Profiler/Profiler.h"
+#include <algorithm>
+
+/*
+====================================================
+SceneBatch::SceneBatch
+====================================================
+*/
+SceneBatch::SceneBatch(const int numThreads) :
+	m_jobSystem(NULL) {
+	if (numThreads > 1)
+		m_jobSystem = new JobSystem(numThreads);
+	m_scratch.resize((NULL != m_jobSystem) ? m_jobSystem->GetNumThreads() : 1);
+}
+
+/*
+====================================================
+SceneBatch::~SceneBatch
+====================================================
+*/
+SceneBatch::~SceneBatch() {
+	delete m_jobSystem;
+	m_jobSystem = NULL;
+}
+
+/*
+====================================================
+SceneBatch::AddScene
+====================================================
+*/
+bool SceneBatch::AddScene(Scene* scene) {
+	// a scene with its own job system would wait on it from inside a job of this one
+	if (NULL == scene || scene->GetNumThreads() > 1)
+		return false;
+	if (std::find(m_scenes.begin(), m_scenes.end(), scene) != m_scenes.end())
+		return false;
+
+	m_scenes.push_back(scene);
+	return true;
+}
+
+/*
+====================================================
+SceneBatch::RemoveScene
+====================================================
+*/
+bool SceneBatch::RemoveScene(Scene* scene) {
+	std::vector<Scene*>::iterator it = std::find(m_scenes.begin(), m_scenes.end(), scene);
+	if (it == m_scenes.end())
+		return false;
+
+	m_scenes.erase(it);
+	return true;
+}
+
+/*
+====================================================
+SceneBatch::BalanceScenes
+====================================================
+*/
+void SceneBatch::BalanceScenes() {
+	const int numScenes = static_cast<int>(m_scenes.size());
+	const int numThreads = static_cast<int>(m_scratch.size());
+
+	// a few bins per thread leaves room for stealing, like ParallelFor's batches
+	const int numBins = std::min(numScenes, numThreads * 4);
+
+	// the largest scene goes into the lightest bin first, the step cost follows the body count closely enough
+	m_sceneOrder.resize(numScenes);
+	for (int sceneIndex = 0; sceneIndex < numScenes; ++sceneIndex)
+		m_sceneOrder[sceneIndex] = sceneIndex;
+	std::sort(m_sceneOrder.begin(), m_sceneOrder.end(), [this](const int lhs, const int rhs) {
+		const size_t lhsBodies = m_scenes[lhs]->m_bodies.size();
+		const size_t rhsBodies = m_scenes[rhs]->m_bodies.size();
+		return (lhsBodies != rhsBodies) ? (lhsBodies > rhsBodies) : (lhs < rhs);
+	});
+
+	m_binLoads.assign(numBins, 0);
+	m_sceneBins.resize(numScenes);
+	for (int orderIndex = 0; orderIndex < numScenes; ++orderIndex) {
+		const int sceneIndex = m_sceneOrder[orderIndex];
+		const int binIndex = static_cast<int>(std::min_element(m_binLoads.begin(), m_binLoads.end()) - m_binLoads.begin());
+		m_binLoads[binIndex] += static_cast<int>(m_scenes[sceneIndex]->m_bodies.size()) + 1;
+		m_sceneBins[sceneIndex] = binIndex;
+	}
+
+	// counting sort of the scenes by bin
+	m_binStarts.assign(numBins + 1, 0);
+	for (int sceneIndex = 0; sceneIndex < numScenes; ++sceneIndex)
+		m_binStarts[m_sceneBins[sceneIndex] + 1]++;
+	for (int binIndex = 0; binIndex < numBins; ++binIndex)
+		m_binStarts[binIndex + 1] += m_binStarts[binIndex];
+	m_binScenes.resize(numScenes);
+	m_binLoads.assign(numBins, 0);	// reused as the fill count of every bin
+	for (int sceneIndex = 0; sceneIndex < numScenes; ++sceneIndex) {
+		const int binIndex = m_sceneBins[sceneIndex];
+		m_binScenes[m_binStarts[binIndex] + m_binLoads[binIndex]++] = sceneIndex;
+	}
+}
+
+/*
+====================================================
+SceneBatch::Update
+====================================================
+*/
+void SceneBatch::Update(const float deltaSecond) {
+	PROFILE_SCOPE("SceneBatch");
+
+	if (NULL == m_jobSystem) {
+		for (Scene* scene : m_scenes)
+			scene->Update(deltaSecond, m_scratch[0]);
+		return;
+	}
+
+	// the body counts change between steps, so the bins are rebuilt every time, it's cheap next to the steps
+	BalanceScenes();
+	const int numBins = static_cast<int>(m_binStarts.size()) - 1;
+	m_jobSystem->ParallelFor(numBins, 1, [this, deltaSecond](int begin, int end) {
+		// only this thread comes into the pool from outside, so it has index 0 to itself
+		stepScratch_t& scratch = m_scratch[m_jobSystem->GetThreadIndex()];
+		for (int binIndex = begin; binIndex < end; ++binIndex) {
+			for (int binSceneIndex = m_binStarts[binIndex]; binSceneIndex < m_binStarts[binIndex + 1]; ++binSceneIndex)
+				m_scenes[m_binScenes[binSceneIndex]]->Update(deltaSecond, scratch);
+		}
+	});
+}
+
+/*
+====================================================
+SceneBatch::GetScratchBytes
+====================================================
+*/
+size_t SceneBatch::GetScratchBytes() const {
+	size_t numBytes = 0;
+	for (const stepScratch_t& scratch : m_scratch)
+		numBytes += scratch.GetNumBytes();
+	for (const Scene* scene : m_scenes)
+		numBytes += scene->GetScratchBytes();
+	return numBytes;
+}
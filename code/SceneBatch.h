@@ -0,0 +1,54 @@
+//
+//  SceneBatch.h
+//
+#pragma once
+#include <vector>
+
+#include "Scene.h"
+
+class JobSystem;
+
+/*
+====================================================
+SceneBatch
+// Steps many small independent scenes in parallel on one worker pool,
+// for example a server hosting a match per scene. Every scene runs on a
+// single worker, so the scenes have to be created with one thread. The
+// workers lend their scratch buffers to the scenes they step, so the
+// scratch memory grows with the number of threads instead of the number
+// of scenes.
+====================================================
+*/
+class SceneBatch {
+public:
+	explicit SceneBatch( const int numThreads );
+	~SceneBatch();
+
+	// The batch doesn't own the scenes, remove a scene before deleting it
+	bool AddScene( Scene * scene );
+	bool RemoveScene( Scene * scene );
+	int GetNumScenes() const { return static_cast< int >( m_scenes.size() ); }
+	Scene * GetScene( const int sceneIndex ) { return m_scenes[ sceneIndex ]; }
+
+	// Calls Update on every scene once and returns when all of them are done
+	void Update( const float deltaSecond );
+
+	size_t GetScratchBytes() const;
+
+private:
+	SceneBatch( const SceneBatch & );
+	SceneBatch & operator = ( const SceneBatch & );
+
+	void BalanceScenes();
+
+	JobSystem * m_jobSystem;	// NULL when running on a single thread
+	std::vector< Scene * > m_scenes;
+	std::vector< stepScratch_t > m_scratch;	// one per worker
+
+	// the scenes grouped into bins of about the same number of bodies, bin i is m_binScenes[ m_binStarts[ i ], m_binStarts[ i + 1 ] )
+	std::vector< int > m_binScenes;
+	std::vector< int > m_binStarts;
+	std::vector< int > m_sceneOrder;
+	std::vector< int > m_binLoads;
+	std::vector< int > m_sceneBins;
+};
@@ -0,0 +1,96 @@
+//
+//  SceneSnapshot.cpp
+//
+#include "SceneSnapshot.h"
+#include "Scene.h"
+
+/*
+========================================================================================================
+
+SceneSnapshot
+
+========================================================================================================
+*/
+
+/*
+====================================================
+SceneSnapshot::Reserve
+====================================================
+*/
+void SceneSnapshot::Reserve(const int maxBodies) {
+	m_handles.reserve(maxBodies);
+	m_bodyStates.reserve(maxBodies);
+	// room for one sensor overlap per body, a scene with more grows the snapshot once and keeps it
+	m_sensorOverlaps.reserve(maxBodies);
+}
+
+/*
+====================================================
+SceneSnapshot::GetNumBytes
+====================================================
+*/
+size_t SceneSnapshot::GetNumBytes() const {
+	return m_handles.capacity() * sizeof(bodyHandle_t) + m_bodyStates.capacity() * sizeof(bodyState_t) + m_sensorOverlaps.capacity() * sizeof(sensorOverlap_t);
+}
+
+/*
+========================================================================================================
+
+SnapshotRing
+
+========================================================================================================
+*/
+
+/*
+====================================================
+SnapshotRing::Initialize
+====================================================
+*/
+void SnapshotRing::Initialize(const int numSnapshots, const int maxBodies) {
+	m_snapshots.clear();
+	m_snapshots.resize(numSnapshots);
+	for (int i = 0; i < numSnapshots; ++i)
+		m_snapshots[i].Reserve(maxBodies);
+}
+
+/*
+====================================================
+SnapshotRing::Save
+====================================================
+*/
+bool SnapshotRing::Save(const Scene& scene) {
+	if (m_snapshots.empty())
+		return false;
+
+	const int64_t step = scene.GetStepStats().step;
+	SceneSnapshot& snapshot = m_snapshots[step % m_snapshots.size()];
+	scene.SaveState(snapshot);
+	return true;
+}
+
+/*
+====================================================
+SnapshotRing::Find
+====================================================
+*/
+const SceneSnapshot* SnapshotRing::Find(const int64_t step) const {
+	if (m_snapshots.empty() || step < 0)
+		return NULL;
+
+	const SceneSnapshot& snapshot = m_snapshots[step % m_snapshots.size()];
+	if (snapshot.GetStep() != step)
+		return NULL;
+	return &snapshot;
+}
+
+/*
+====================================================
+SnapshotRing::Restore
+====================================================
+*/
+bool SnapshotRing::Restore(Scene& scene, const int64_t step) const {
+	const SceneSnapshot* snapshot = Find(step);
+	if (NULL == snapshot)
+		return false;
+	return scene.RestoreState(*snapshot);
+}
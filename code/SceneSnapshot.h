@@ -0,0 +1,73 @@
+//
+//  SceneSnapshot.h
+//
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+#include "Math/Vector.h"
+#include "Math/Quat.h"
+#include "Physics/BodyHandles.h"
+#include "Physics/SensorEvents.h"
+
+/*
+====================================================
+bodyState_t
+// The part of a body that changes while stepping
+====================================================
+*/
+struct bodyState_t {
+	Vec3 position;
+	Quat orientation;
+	Vec3 linearVelocity;
+	Vec3 angularVelocity;
+	Vec3 restPosition;
+	int numRestingSteps;
+	bool isSleeping;
+};
+
+/*
+====================================================
+SceneSnapshot
+// Reserve once for the largest body count, after that saving and
+// restoring don't allocate while there are no more sensor overlaps
+// than bodies.
+====================================================
+*/
+class SceneSnapshot {
+public:
+	SceneSnapshot() : m_step( -1 ), m_accumulator( 0.0f ) {}
+
+	void Reserve( const int maxBodies );
+	bool IsValid() const { return m_step >= 0; }
+	int64_t GetStep() const { return m_step; }	// number of steps the scene had taken when saved
+	int GetNumBodies() const { return static_cast< int >( m_bodyStates.size() ); }
+	size_t GetNumBytes() const;
+
+private:
+	friend class Scene;
+
+	int64_t m_step;
+	float m_accumulator;
+	std::vector< bodyHandle_t > m_handles;
+	std::vector< bodyState_t > m_bodyStates;
+	std::vector< sensorOverlap_t > m_sensorOverlaps;	// so the first step after a restore sends the same sensor events
+};
+
+/*
+====================================================
+SnapshotRing
+// Keeps the last N snapshots, indexed by the step they were saved at
+====================================================
+*/
+class SnapshotRing {
+public:
+	void Initialize( const int numSnapshots, const int maxBodies );
+
+	bool Save( const class Scene & scene );
+	bool Restore( class Scene & scene, const int64_t step ) const;	// false if that step isn't in the ring anymore
+	const SceneSnapshot * Find( const int64_t step ) const;
+
+private:
+	std::vector< SceneSnapshot > m_snapshots;
+};
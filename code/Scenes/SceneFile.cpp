@@ -0,0 +1,332 @@
+//
+//  SceneFile.cpp
+//
+#include "SceneFile.h"
+#include "../Scene.h"
+#include <stdio.h>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+
+#if defined( _WIN32 )
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert( sizeof( sceneFileHeader_t ) == 64, "scene file header layout changed" );
+static_assert( sizeof( sceneFileShape_t ) == 16, "scene file shape layout changed" );
+static_assert( sizeof( sceneFileBody_t ) == 80, "scene file body layout changed" );
+
+static bool IsLittleEndian() {
+	const uint32_t one = 1;
+	uint8_t firstByte;
+	memcpy( &firstByte, &one, 1 );
+	return 1 == firstByte;
+}
+
+static uint64_t AlignOffset( const uint64_t offset ) {
+	return ( offset + 15 ) & ~uint64_t( 15 );
+}
+
+// offset and count come from the file, so they're checked without computing offset + count * recordSize, which can wrap
+static bool IsTableInFile( const uint64_t offset, const uint64_t count, const uint64_t recordSize, const uint64_t fileSize ) {
+	return offset <= fileSize && count <= ( fileSize - offset ) / recordSize;
+}
+
+/*
+====================================================
+MappedFile
+// Read only view of a whole file
+====================================================
+*/
+class MappedFile {
+public:
+	MappedFile() : m_data( NULL ), m_size( 0 ) {}
+	~MappedFile() { Close(); }
+
+	bool Open( const char * fileName );
+	void Close();
+
+	const uint8_t * GetData() const { return m_data; }
+	uint64_t GetSize() const { return m_size; }
+
+private:
+	const uint8_t * m_data;
+	uint64_t m_size;
+#if defined( _WIN32 )
+	HANDLE m_file;
+	HANDLE m_mapping;
+#endif
+};
+
+#if defined( _WIN32 )
+bool MappedFile::Open( const char * fileName ) {
+	m_file = CreateFileA( fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+	if ( INVALID_HANDLE_VALUE == m_file ) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	m_mapping = NULL;
+	if ( GetFileSizeEx( m_file, &size ) && size.QuadPart > 0 ) {
+		m_mapping = CreateFileMappingA( m_file, NULL, PAGE_READONLY, 0, 0, NULL );
+	}
+	if ( NULL == m_mapping ) {
+		CloseHandle( m_file );
+		return false;
+	}
+
+	m_data = static_cast< const uint8_t * >( MapViewOfFile( m_mapping, FILE_MAP_READ, 0, 0, 0 ) );
+	if ( NULL == m_data ) {
+		CloseHandle( m_mapping );
+		CloseHandle( m_file );
+		return false;
+	}
+	m_size = uint64_t( size.QuadPart );
+	return true;
+}
+
+void MappedFile::Close() {
+	if ( NULL == m_data ) {
+		return;
+	}
+	UnmapViewOfFile( m_data );
+	CloseHandle( m_mapping );
+	CloseHandle( m_file );
+	m_data = NULL;
+	m_size = 0;
+}
+#else
+bool MappedFile::Open( const char * fileName ) {
+	const int file = open( fileName, O_RDONLY );
+	if ( file < 0 ) {
+		return false;
+	}
+
+	struct stat info;
+	if ( 0 != fstat( file, &info ) || info.st_size <= 0 ) {
+		close( file );
+		return false;
+	}
+
+	// the mapping keeps the file alive, the descriptor isn't needed anymore
+	void * data = mmap( NULL, size_t( info.st_size ), PROT_READ, MAP_PRIVATE, file, 0 );
+	close( file );
+	if ( MAP_FAILED == data ) {
+		return false;
+	}
+	madvise( data, size_t( info.st_size ), MADV_SEQUENTIAL );
+
+	m_data = static_cast< const uint8_t * >( data );
+	m_size = uint64_t( info.st_size );
+	return true;
+}
+
+void MappedFile::Close() {
+	if ( NULL == m_data ) {
+		return;
+	}
+	munmap( const_cast< uint8_t * >( m_data ), size_t( m_size ) );
+	m_data = NULL;
+	m_size = 0;
+}
+#endif
+
+/*
+====================================================
+WriteBody
+====================================================
+*/
+static void WriteBody( const Body & body, const uint32_t shapeIndex, sceneFileBody_t & record ) {
+	memset( &record, 0, sizeof( record ) );
+	record.position[ 0 ] = body.m_position.x;
+	record.position[ 1 ] = body.m_position.y;
+	record.position[ 2 ] = body.m_position.z;
+	record.orientation[ 0 ] = body.m_orientation.x;
+	record.orientation[ 1 ] = body.m_orientation.y;
+	record.orientation[ 2 ] = body.m_orientation.z;
+	record.orientation[ 3 ] = body.m_orientation.w;
+	record.linearVelocity[ 0 ] = body.m_linearVelocity.x;
+	record.linearVelocity[ 1 ] = body.m_linearVelocity.y;
+	record.linearVelocity[ 2 ] = body.m_linearVelocity.z;
+	record.angularVelocity[ 0 ] = body.m_angularVelocity.x;
+	record.angularVelocity[ 1 ] = body.m_angularVelocity.y;
+	record.angularVelocity[ 2 ] = body.m_angularVelocity.z;
+	record.invMass = body.m_invMass;
+	record.elasticity = body.m_elasticity;
+	record.friction = body.m_friction;
+	record.shapeIndex = shapeIndex;
+	record.collisionGroup = body.m_collisionGroup;
+	record.collisionMask = body.m_collisionMask;
+	record.flags = ( body.m_isSensor ? SCENE_FILE_BODY_SENSOR : 0 ) | ( body.m_isBullet ? SCENE_FILE_BODY_BULLET : 0 );
+}
+
+/*
+====================================================
+SaveSceneFile
+====================================================
+*/
+bool SaveSceneFile( const Scene & scene, const char * fileName ) {
+	if ( !IsLittleEndian() ) {
+		printf( "SaveSceneFile: big-endian hosts aren't supported\n" );
+		return false;
+	}
+
+	// bodies share shapes, so the shape table gets one entry per distinct shape
+	std::vector< sceneFileShape_t > shapes;
+	std::unordered_map< const Shape *, uint32_t > shapeIndices;
+	std::vector< uint32_t > bodyShapeIndices( scene.m_bodies.size() );
+	int numStaticBodies = 0;
+	for ( int i = 0; i < scene.m_bodies.size(); i++ ) {
+		const Body & body = scene.m_bodies[ i ];
+		if ( 0.0f == body.m_invMass ) {
+			numStaticBodies++;
+		}
+
+		std::unordered_map< const Shape *, uint32_t >::const_iterator it = shapeIndices.find( body.m_shape );
+		if ( it != shapeIndices.end() ) {
+			bodyShapeIndices[ i ] = it->second;
+			continue;
+		}
+
+		if ( Shape::SHAPE_SPHERE != body.m_shape->GetType() ) {
+			printf( "SaveSceneFile: body %i has a shape that can't be saved yet\n", i );
+			return false;
+		}
+		sceneFileShape_t shape;
+		memset( &shape, 0, sizeof( shape ) );
+		shape.type = Shape::SHAPE_SPHERE;
+		shape.parameters[ 0 ] = static_cast< const ShapeSphere * >( body.m_shape )->m_radius;
+
+		const uint32_t shapeIndex = static_cast< uint32_t >( shapes.size() );
+		shapes.push_back( shape );
+		shapeIndices[ body.m_shape ] = shapeIndex;
+		bodyShapeIndices[ i ] = shapeIndex;
+	}
+
+	sceneFileHeader_t header;
+	memset( &header, 0, sizeof( header ) );
+	header.magic = SCENE_FILE_MAGIC;
+	header.version = SCENE_FILE_VERSION;
+	header.headerSize = sizeof( sceneFileHeader_t );
+	header.numShapes = static_cast< uint32_t >( shapes.size() );
+	header.numStaticBodies = numStaticBodies;
+	header.numDynamicBodies = static_cast< uint32_t >( scene.m_bodies.size() ) - numStaticBodies;
+	header.shapeSize = sizeof( sceneFileShape_t );
+	header.bodySize = sizeof( sceneFileBody_t );
+	header.shapeOffset = AlignOffset( sizeof( sceneFileHeader_t ) );
+	header.bodyOffset = AlignOffset( header.shapeOffset + shapes.size() * sizeof( sceneFileShape_t ) );
+
+	std::vector< sceneFileBody_t > bodies( scene.m_bodies.size() );
+	int staticIndex = 0;
+	int dynamicIndex = numStaticBodies;
+	for ( int i = 0; i < scene.m_bodies.size(); i++ ) {
+		const Body & body = scene.m_bodies[ i ];
+		const int recordIndex = ( 0.0f == body.m_invMass ) ? staticIndex++ : dynamicIndex++;
+		WriteBody( body, bodyShapeIndices[ i ], bodies[ recordIndex ] );
+	}
+
+	FILE * file = fopen( fileName, "wb" );
+	if ( NULL == file ) {
+		return false;
+	}
+
+	// every table starts right where the previous one ended, the sizes are all multiples of 16
+	bool isWritten = ( 1 == fwrite( &header, sizeof( header ), 1, file ) );
+	if ( isWritten && !shapes.empty() ) {
+		isWritten = ( shapes.size() == fwrite( shapes.data(), sizeof( sceneFileShape_t ), shapes.size(), file ) );
+	}
+	if ( isWritten && !bodies.empty() ) {
+		isWritten = ( bodies.size() == fwrite( bodies.data(), sizeof( sceneFileBody_t ), bodies.size(), file ) );
+	}
+	if ( 0 != fclose( file ) ) {
+		isWritten = false;
+	}
+	return isWritten;
+}
+
+/*
+====================================================
+LoadSceneFile
+====================================================
+*/
+bool LoadSceneFile( Scene & scene, const char * fileName ) {
+	if ( !IsLittleEndian() ) {
+		printf( "LoadSceneFile: big-endian hosts aren't supported\n" );
+		return false;
+	}
+
+	MappedFile file;
+	if ( !file.Open( fileName ) ) {
+		printf( "LoadSceneFile: can't open %s\n", fileName );
+		return false;
+	}
+
+	const sceneFileHeader_t * header = reinterpret_cast< const sceneFileHeader_t * >( file.GetData() );
+	if ( file.GetSize() < sizeof( sceneFileHeader_t ) || SCENE_FILE_MAGIC != header->magic ) {
+		printf( "LoadSceneFile: %s isn't a scene file\n", fileName );
+		return false;
+	}
+	if ( header->version < 1 || header->version > SCENE_FILE_VERSION || sizeof( sceneFileHeader_t ) != header->headerSize ||
+		sizeof( sceneFileShape_t ) != header->shapeSize || sizeof( sceneFileBody_t ) != header->bodySize ) {
+		printf( "LoadSceneFile: %s has version %u, expected 1 to %u\n", fileName, header->version, SCENE_FILE_VERSION );
+		return false;
+	}
+
+	const uint64_t numBodies = uint64_t( header->numStaticBodies ) + header->numDynamicBodies;
+	if ( !IsTableInFile( header->shapeOffset, header->numShapes, sizeof( sceneFileShape_t ), file.GetSize() ) ||
+		!IsTableInFile( header->bodyOffset, numBodies, sizeof( sceneFileBody_t ), file.GetSize() ) ||
+		0 != ( header->shapeOffset & 15 ) || 0 != ( header->bodyOffset & 15 ) ) {
+		printf( "LoadSceneFile: %s is truncated\n", fileName );
+		return false;
+	}
+
+	const sceneFileShape_t * shapes = reinterpret_cast< const sceneFileShape_t * >( file.GetData() + header->shapeOffset );
+	const sceneFileBody_t * bodies = reinterpret_cast< const sceneFileBody_t * >( file.GetData() + header->bodyOffset );
+
+	// the shape table is small, intern it into the library and remap the indices
+	std::vector< int > shapeIndices( header->numShapes );
+	for ( uint32_t i = 0; i < header->numShapes; i++ ) {
+		if ( Shape::SHAPE_SPHERE != shapes[ i ].type ) {
+			printf( "LoadSceneFile: shape %u has unknown type %u\n", i, shapes[ i ].type );
+			return false;
+		}
+		shapeIndices[ i ] = scene.m_shapes.AddSphere( shapes[ i ].parameters[ 0 ] );
+	}
+	for ( uint64_t i = 0; i < numBodies; i++ ) {
+		if ( bodies[ i ].shapeIndex >= header->numShapes ) {
+			printf( "LoadSceneFile: body %llu refers to missing shape %u\n", (unsigned long long)i, bodies[ i ].shapeIndex );
+			return false;
+		}
+	}
+
+	// one pass straight out of the mapped pages into the body array
+	scene.ReserveBodies( static_cast< int >( scene.m_bodies.size() + numBodies ) );
+	const bool hasCollisionFilter = ( header->version >= 2 );
+	Body body;
+	for ( uint64_t i = 0; i < numBodies; i++ ) {
+		const sceneFileBody_t & record = bodies[ i ];
+		body.m_position = Vec3( record.position[ 0 ], record.position[ 1 ], record.position[ 2 ] );
+		body.m_orientation = Quat( record.orientation[ 0 ], record.orientation[ 1 ], record.orientation[ 2 ], record.orientation[ 3 ] );
+		body.m_linearVelocity = Vec3( record.linearVelocity[ 0 ], record.linearVelocity[ 1 ], record.linearVelocity[ 2 ] );
+		body.m_angularVelocity = Vec3( record.angularVelocity[ 0 ], record.angularVelocity[ 1 ], record.angularVelocity[ 2 ] );
+		body.m_invMass = record.invMass;
+		body.m_elasticity = record.elasticity;
+		body.m_friction = record.friction;
+		body.m_shapeIndex = shapeIndices[ record.shapeIndex ];
+		body.m_shape = scene.m_shapes.GetShape( body.m_shapeIndex );
+		if ( hasCollisionFilter ) {
+			body.m_collisionGroup = record.collisionGroup;
+			body.m_collisionMask = record.collisionMask;
+			body.m_isSensor = ( 0 != ( record.flags & SCENE_FILE_BODY_SENSOR ) );
+			body.m_isBullet = ( 0 != ( record.flags & SCENE_FILE_BODY_BULLET ) );
+		}
+		scene.AddBody( body );
+	}
+	return true;
+}
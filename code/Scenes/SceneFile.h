@@ -0,0 +1,76 @@
+//
+//  SceneFile.h
+//
+//	Binary scene files, little-endian, every table 16 byte aligned:
+//
+//	sceneFileHeader_t
+//	sceneFileShape_t[ numShapes ]
+//	sceneFileBody_t[ numStaticBodies ]		static bodies first, then
+//	sceneFileBody_t[ numDynamicBodies ]		the dynamic ones
+//
+//	The records have no pointers or padding, so a mapped file can be read in place.
+//
+#pragma once
+#include <stdint.h>
+
+class Scene;
+
+#define SCENE_FILE_MAGIC	0x4e435350	// "PSCN"
+#define SCENE_FILE_BODY_SENSOR	0x1
+#define SCENE_FILE_BODY_BULLET	0x2
+
+#define SCENE_FILE_VERSION	2	// 2 added the collision group, mask and body flags, version 1 files still load
+
+/*
+====================================================
+sceneFileHeader_t
+====================================================
+*/
+struct sceneFileHeader_t {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t headerSize;
+	uint32_t numShapes;
+	uint32_t numStaticBodies;
+	uint32_t numDynamicBodies;
+	uint32_t shapeSize;		// sizeof( sceneFileShape_t )
+	uint32_t bodySize;		// sizeof( sceneFileBody_t )
+	uint64_t shapeOffset;	// from the start of the file
+	uint64_t bodyOffset;
+	uint32_t reserved[ 4 ];
+};
+
+/*
+====================================================
+sceneFileShape_t
+====================================================
+*/
+struct sceneFileShape_t {
+	uint32_t type;			// Shape::shapeType_t
+	float parameters[ 3 ];	// radius for spheres
+};
+
+/*
+====================================================
+sceneFileBody_t
+====================================================
+*/
+struct sceneFileBody_t {
+	float position[ 3 ];
+	float orientation[ 4 ];	// x y z w
+	float linearVelocity[ 3 ];
+	float angularVelocity[ 3 ];
+	float invMass;
+	float elasticity;
+	float friction;
+	uint32_t shapeIndex;	// into the shape table of the file
+	uint32_t collisionGroup;
+	uint32_t collisionMask;
+	uint32_t flags;			// SCENE_FILE_BODY_*
+};
+
+// Bakes the bodies of a live scene, fails on shapes that have no file representation yet
+bool SaveSceneFile( const Scene & scene, const char * fileName );
+
+// Appends the bodies of the file to the scene, static bodies come first
+bool LoadSceneFile( Scene & scene, const char * fileName );
@@ -0,0 +1,239 @@
+//
+//  StressScenes.cpp
+//
+#include "StressScenes.h"
+#include "../Scene.h"
+#include "../Physics/Shapes/ShapeHeightfield.h"
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+/*
+====================================================
+RandomFloat
+// Small LCG so every run builds exactly the same scene, returns [0,1)
+====================================================
+*/
+static float RandomFloat( unsigned int & seed ) {
+	seed = seed * 1664525u + 1013904223u;
+	return float( seed >> 8 ) / float( 1 << 24 );
+}
+
+static int CubeRoot( const int num ) {
+	int side = (int)ceilf( powf( (float)num, 1.0f / 3.0f ) );
+	while ( side > 1 && ( side - 1 ) * ( side - 1 ) * ( side - 1 ) >= num ) {
+		side--;
+	}
+	return side;
+}
+
+static int SquareRoot( const int num ) {
+	int side = (int)ceilf( sqrtf( (float)num ) );
+	while ( side > 1 && ( side - 1 ) * ( side - 1 ) >= num ) {
+		side--;
+	}
+	return side;
+}
+
+static void AddSphere( Scene & scene, const Vec3 & position, const float radius, const float invMass, const Vec3 & velocity ) {
+	Body body;
+	body.m_position = position;
+	body.m_orientation = Quat( 0, 0, 0, 1 );
+	body.m_linearVelocity = velocity;
+	body.m_angularVelocity.Zero();
+	body.m_invMass = invMass;
+	body.m_elasticity = 0.5f;
+	body.m_friction = 0.5f;
+	body.m_shapeIndex = scene.m_shapes.AddSphere( radius );
+	body.m_shape = scene.m_shapes.GetShape( body.m_shapeIndex );
+	scene.AddBody( body );
+}
+
+/*
+====================================================
+AddGround
+// A huge static sphere, like the floor of the default scene
+====================================================
+*/
+static void AddGround( Scene & scene ) {
+	const float radius = 10000.0f;
+	AddSphere( scene, Vec3( 0.0f, 0.0f, -radius ), radius, 0.0f, Vec3( 0.0f ) );
+}
+
+/*
+====================================================
+BuildSphereRain
+====================================================
+*/
+static void BuildSphereRain( Scene & scene, const int numBodies ) {
+	AddGround( scene );
+
+	unsigned int seed = 1;
+	const int side = CubeRoot( numBodies );
+	const float spacing = 2.0f;
+	for ( int i = 0; i < numBodies; i++ ) {
+		const int x = i % side;
+		const int y = ( i / side ) % side;
+		const int z = i / ( side * side );
+
+		Vec3 position;
+		position.x = ( float( x ) - float( side ) * 0.5f ) * spacing + ( RandomFloat( seed ) - 0.5f ) * 0.5f;
+		position.y = ( float( y ) - float( side ) * 0.5f ) * spacing + ( RandomFloat( seed ) - 0.5f ) * 0.5f;
+		position.z = 10.0f + float( z ) * spacing;
+		const Vec3 velocity( 0.0f, 0.0f, -5.0f * RandomFloat( seed ) );
+		AddSphere( scene, position, 0.5f, 1.0f, velocity );
+	}
+}
+
+/*
+====================================================
+BuildTallPile
+// A 4x4 column of touching spheres that collapses
+====================================================
+*/
+static void BuildTallPile( Scene & scene, const int numBodies ) {
+	AddGround( scene );
+
+	const int side = 4;
+	for ( int i = 0; i < numBodies; i++ ) {
+		const int x = i % side;
+		const int y = ( i / side ) % side;
+		const int z = i / ( side * side );
+		const Vec3 position( float( x ) - 1.5f, float( y ) - 1.5f, 0.5f + float( z ) );
+		AddSphere( scene, position, 0.5f, 1.0f, Vec3( 0.0f ) );
+	}
+}
+
+/*
+====================================================
+BuildFlatCarpet
+// One layer of touching spheres on the ground. Along the (1,1,1) sweep
+// axis every row overlaps its neighbours, the worst case for the SAP.
+====================================================
+*/
+static void BuildFlatCarpet( Scene & scene, const int numBodies ) {
+	AddGround( scene );
+
+	const int side = SquareRoot( numBodies );
+	for ( int i = 0; i < numBodies; i++ ) {
+		const int x = i % side;
+		const int y = i / side;
+		const Vec3 position( float( x ) - float( side ) * 0.5f, float( y ) - float( side ) * 0.5f, 0.5f );
+		AddSphere( scene, position, 0.5f, 1.0f, Vec3( 0.0f ) );
+	}
+}
+
+/*
+====================================================
+BuildMixedField
+====================================================
+*/
+static void BuildMixedField( Scene & scene, const int numBodies ) {
+	AddGround( scene );
+
+	const float radii[] = { 0.25f, 0.5f, 1.0f, 2.0f };
+	unsigned int seed = 7;
+	const int side = CubeRoot( numBodies );
+	const float spacing = 4.5f;
+	for ( int i = 0; i < numBodies; i++ ) {
+		const int x = i % side;
+		const int y = ( i / side ) % side;
+		const int z = i / ( side * side );
+
+		const float radius = radii[ (int)( RandomFloat( seed ) * 4.0f ) & 3 ];
+		const Vec3 position( ( float( x ) - float( side ) * 0.5f ) * spacing, ( float( y ) - float( side ) * 0.5f ) * spacing, 2.0f + float( z ) * spacing );
+		AddSphere( scene, position, radius, 1.0f / ( radius * radius * radius ), Vec3( 0.0f ) );
+	}
+}
+
+/*
+====================================================
+BuildBoxStack
+// The narrowphase only handles spheres, so the box is a cube of touching spheres
+====================================================
+*/
+static void BuildBoxStack( Scene & scene, const int numBodies ) {
+	AddGround( scene );
+
+	const int side = CubeRoot( numBodies );
+	for ( int i = 0; i < numBodies; i++ ) {
+		const int x = i % side;
+		const int y = ( i / side ) % side;
+		const int z = i / ( side * side );
+		const Vec3 position( float( x ) - float( side ) * 0.5f, float( y ) - float( side ) * 0.5f, 0.5f + float( z ) );
+		AddSphere( scene, position, 0.5f, 1.0f, Vec3( 0.0f ) );
+	}
+}
+
+/*
+====================================================
+BuildTerrain
+// Spheres dropped onto rolling hills, the ground is a heightfield
+// instead of a huge sphere
+====================================================
+*/
+static void BuildTerrain( Scene & scene, const int numBodies ) {
+	const int side = SquareRoot( numBodies );
+	const float spacing = 2.0f;
+	const float cellSize = 1.0f;
+	const int numSamples = (int)( float( side ) * spacing / cellSize ) + 9;
+	const float halfWidth = float( numSamples - 1 ) * cellSize * 0.5f;
+
+	std::vector< float > heights( numSamples * numSamples );
+	for ( int y = 0; y < numSamples; y++ ) {
+		for ( int x = 0; x < numSamples; x++ ) {
+			const float fx = float( x ) * cellSize;
+			const float fy = float( y ) * cellSize;
+			heights[ y * numSamples + x ] = 1.5f * sinf( fx * 0.2f ) * cosf( fy * 0.15f ) + 0.5f * sinf( ( fx + fy ) * 0.5f );
+		}
+	}
+
+	Body ground;
+	ground.m_position = Vec3( -halfWidth, -halfWidth, 0.0f );
+	ground.m_orientation = Quat( 0, 0, 0, 1 );
+	ground.m_linearVelocity.Zero();
+	ground.m_angularVelocity.Zero();
+	ground.m_invMass = 0.0f;
+	ground.m_elasticity = 0.5f;
+	ground.m_friction = 0.5f;
+	ground.m_shapeIndex = scene.m_shapes.AddShape( new ShapeHeightfield( numSamples, numSamples, cellSize, heights.data() ) );
+	ground.m_shape = scene.m_shapes.GetShape( ground.m_shapeIndex );
+	scene.AddBody( ground );
+
+	unsigned int seed = 3;
+	for ( int i = 0; i < numBodies; i++ ) {
+		const int x = i % side;
+		const int y = ( i / side ) % side;
+		const int z = i / ( side * side );
+
+		Vec3 position;
+		position.x = ( float( x ) - float( side - 1 ) * 0.5f ) * spacing + ( RandomFloat( seed ) - 0.5f ) * 0.5f;
+		position.y = ( float( y ) - float( side - 1 ) * 0.5f ) * spacing + ( RandomFloat( seed ) - 0.5f ) * 0.5f;
+		position.z = 4.0f + float( z ) * spacing;
+		AddSphere( scene, position, 0.5f, 1.0f, Vec3( 0.0f ) );
+	}
+}
+
+const stressScene_t g_stressScenes[] = {
+	{ "rain",		"spheres falling onto the ground",			BuildSphereRain },
+	{ "pile",		"tall 4x4 column of touching spheres",		BuildTallPile },
+	{ "carpet",		"single layer of touching spheres",			BuildFlatCarpet },
+	{ "mixed",		"spread out spheres of four sizes",			BuildMixedField },
+	{ "boxstack",	"cube of touching spheres",					BuildBoxStack },
+	{ "terrain",	"spheres dropped onto a heightfield",		BuildTerrain },
+};
+const int g_numStressScenes = sizeof( g_stressScenes ) / sizeof( g_stressScenes[ 0 ] );
+
+/*
+====================================================
+FindStressScene
+====================================================
+*/
+const stressScene_t * FindStressScene( const char * name ) {
+	for ( int i = 0; i < g_numStressScenes; i++ ) {
+		if ( 0 == strcmp( g_stressScenes[ i ].name, name ) ) {
+			return &g_stressScenes[ i ];
+		}
+	}
+	return NULL;
+}
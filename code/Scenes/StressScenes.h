@@ -0,0 +1,24 @@
+//
+//  StressScenes.h
+//
+#pragma once
+
+class Scene;
+
+/*
+====================================================
+stressScene_t
+// Scenes that scale to any number of dynamic bodies, for benchmarks
+// and headless runs. Every scene also adds one static ground body.
+====================================================
+*/
+struct stressScene_t {
+	const char * name;
+	const char * description;
+	void ( *build )( Scene & scene, const int numBodies );
+};
+
+extern const stressScene_t g_stressScenes[];
+extern const int g_numStressScenes;
+
+const stressScene_t * FindStressScene( const char * name );
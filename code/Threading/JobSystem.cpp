@@ -0,0 +1,342 @@
+//
+//  JobSystem.cpp
+//
+#include "JobSystem.h"
+#include "../Profiler/Profiler.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// the pool the calling thread is a worker of, an index is only meaningful in its own pool
+struct threadBinding_t {
+	const JobSystem* owner;
+	int threadIndex;
+};
+static thread_local threadBinding_t t_thread = { NULL, 0 };
+
+/*
+========================================================================================================
+
+TaskGraph
+
+========================================================================================================
+*/
+
+/*
+====================================================
+TaskGraph::AddTask
+====================================================
+*/
+int TaskGraph::AddTask(const char* name, const std::function<void()>& function) {
+	task_t task;
+	task.name = name;
+	task.function = function;
+	task.numDependencies = 0;
+	m_tasks.push_back(task);
+	return static_cast<int>(m_tasks.size()) - 1;
+}
+
+/*
+====================================================
+TaskGraph::AddDependency
+====================================================
+*/
+void TaskGraph::AddDependency(const int task, const int dependsOn) {
+	// depending only on earlier tasks keeps the graph acyclic and the insertion order a valid serial order
+	assert(dependsOn < task);
+	m_tasks[dependsOn].dependents.push_back(task);
+	m_tasks[task].numDependencies++;
+}
+
+/*
+====================================================
+TaskGraph::Clear
+====================================================
+*/
+void TaskGraph::Clear() {
+	m_tasks.clear();
+}
+
+/*
+========================================================================================================
+
+JobSystem
+
+========================================================================================================
+*/
+
+/*
+====================================================
+JobSystem::JobSystem
+====================================================
+*/
+JobSystem::JobSystem(const int numThreads) :
+	m_numThreads((numThreads < 1) ? 1 : numThreads),
+	m_numQueued(0),
+	m_quit(false) {
+	m_workers = new worker_t[m_numThreads];
+
+	// deque 0 is shared by the threads from outside the pool, so only the remaining workers get their own thread
+	m_threads.reserve(m_numThreads - 1);
+	for (int threadIndex = 1; threadIndex < m_numThreads; ++threadIndex)
+		m_threads.push_back(std::thread(&JobSystem::WorkerMain, this, threadIndex));
+}
+
+/*
+====================================================
+JobSystem::~JobSystem
+====================================================
+*/
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(m_wakeMutex);
+		m_quit = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for (int i = 0; i < m_threads.size(); ++i)
+		m_threads[i].join();
+	m_threads.clear();
+
+	delete[] m_workers;
+}
+
+/*
+====================================================
+JobSystem::GetThreadIndex
+====================================================
+*/
+int JobSystem::GetThreadIndex() const {
+	return (this == t_thread.owner) ? t_thread.threadIndex : 0;
+}
+
+/*
+====================================================
+JobSystem::Push
+====================================================
+*/
+void JobSystem::Push(job_t* job) {
+	worker_t& worker = m_workers[GetThreadIndex()];
+	{
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.jobs.push_back(job);
+	}
+	m_numQueued++;
+
+	// taking the lock makes sure a worker that is about to sleep sees the new job
+	{
+		std::lock_guard<std::mutex> lock(m_wakeMutex);
+	}
+	m_wakeCondition.notify_one();
+}
+
+/*
+====================================================
+JobSystem::Pop
+====================================================
+*/
+JobSystem::job_t* JobSystem::Pop(const int threadIndex) {
+	worker_t& worker = m_workers[threadIndex];
+	std::lock_guard<std::mutex> lock(worker.mutex);
+	if (worker.jobs.empty())
+		return NULL;
+
+	// newest first, its data is most likely still in the cache
+	job_t* job = worker.jobs.back();
+	worker.jobs.pop_back();
+	m_numQueued--;
+	return job;
+}
+
+/*
+====================================================
+JobSystem::Steal
+====================================================
+*/
+JobSystem::job_t* JobSystem::Steal(const int threadIndex) {
+	for (int offset = 1; offset < m_numThreads; ++offset) {
+		worker_t& victim = m_workers[(threadIndex + offset) % m_numThreads];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (victim.jobs.empty())
+			continue;
+
+		// oldest first, those tend to be the biggest chunks of work
+		job_t* job = victim.jobs.front();
+		victim.jobs.pop_front();
+		m_numQueued--;
+		return job;
+	}
+	return NULL;
+}
+
+/*
+====================================================
+JobSystem::RunOne
+====================================================
+*/
+bool JobSystem::RunOne(const int threadIndex) {
+	job_t* job = Pop(threadIndex);
+	if (NULL == job)
+		job = Steal(threadIndex);
+	if (NULL == job)
+		return false;
+
+	job->function(*job);
+	job->unfinished->fetch_sub(1);
+	return true;
+}
+
+/*
+====================================================
+JobSystem::WaitFor
+====================================================
+*/
+void JobSystem::WaitFor(const std::atomic<int>& unfinished) {
+	// help with any queued work instead of blocking, this also keeps nested parallel loops from deadlocking
+	while (unfinished.load() > 0) {
+		if (!RunOne(GetThreadIndex()))
+			std::this_thread::yield();
+	}
+}
+
+/*
+====================================================
+JobSystem::WorkerMain
+====================================================
+*/
+void JobSystem::WorkerMain(const int threadIndex) {
+	t_thread.owner = this;
+	t_thread.threadIndex = threadIndex;
+
+	char threadName[32];
+	snprintf(threadName, sizeof(threadName), "Worker %d", threadIndex);
+	Profiler::SetThreadName(threadName);
+
+	while (!m_quit) {
+		if (RunOne(threadIndex))
+			continue;
+
+		std::unique_lock<std::mutex> lock(m_wakeMutex);
+		m_wakeCondition.wait(lock, [this] { return m_quit || m_numQueued.load() > 0; });
+	}
+}
+
+/*
+====================================================
+JobSystem::RunParallelForJob
+====================================================
+*/
+void JobSystem::RunParallelForJob(job_t& job) {
+	// graph tasks are zoned by their own code, batches get a zone here so worker activity shows up in traces
+	PROFILE_SCOPE("ParallelFor");
+
+	const std::function<void(int, int)>& function = *reinterpret_cast<const std::function<void(int, int)>*>(job.userData);
+	function(job.begin, job.end);
+}
+
+/*
+====================================================
+JobSystem::ParallelFor
+====================================================
+*/
+void JobSystem::ParallelFor(const int count, const int minBatchSize, const std::function<void(int, int)>& function) {
+	if (count <= 0)
+		return;
+
+	// a few batches per thread leaves room for stealing when the work is uneven
+	const int maxBatches = m_numThreads * 4;
+	int batchSize = (count + maxBatches - 1) / maxBatches;
+	if (batchSize < minBatchSize)
+		batchSize = minBatchSize;
+	if (batchSize < 1)
+		batchSize = 1;
+
+	if (1 == m_numThreads || batchSize >= count) {
+		function(0, count);
+		return;
+	}
+
+	const int numBatches = (count + batchSize - 1) / batchSize;
+	std::atomic<int> unfinished(numBatches);
+	job_t* jobs = reinterpret_cast<job_t*>(alloca(sizeof(job_t) * numBatches));
+	for (int batchIndex = 0; batchIndex < numBatches; ++batchIndex) {
+		job_t& job = jobs[batchIndex];
+		job.function = RunParallelForJob;
+		job.userData = const_cast<std::function<void(int, int)>*>(&function);
+		job.begin = batchIndex * batchSize;
+		job.end = (job.begin + batchSize < count) ? (job.begin + batchSize) : count;
+		job.unfinished = &unfinished;
+	}
+
+	// queue everything but the first batch, which this thread runs right away
+	for (int batchIndex = numBatches - 1; batchIndex > 0; --batchIndex)
+		Push(&jobs[batchIndex]);
+
+	RunParallelForJob(jobs[0]);
+	unfinished--;
+
+	WaitFor(unfinished);
+}
+
+/*
+====================================================
+JobSystem::RunGraphJob
+====================================================
+*/
+void JobSystem::RunGraphJob(job_t& job) {
+	TaskGraph& graph = *reinterpret_cast<TaskGraph*>(job.userData);
+	const TaskGraph::task_t& task = graph.m_tasks[job.begin];
+	task.function();
+
+	// queue the tasks that were only waiting for this one, from the thread that finished it
+	for (int i = 0; i < task.dependents.size(); ++i) {
+		const int dependent = task.dependents[i];
+		if (1 == graph.m_pendingDependencies[dependent].fetch_sub(1))
+			graph.m_jobSystem->Push(&graph.m_jobs[dependent]);
+	}
+}
+
+/*
+====================================================
+JobSystem::Run
+====================================================
+*/
+void JobSystem::Run(TaskGraph& graph) {
+	const int numTasks = graph.GetNumTasks();
+	if (0 == numTasks)
+		return;
+
+	// with a single thread the insertion order is already a valid order
+	if (1 == m_numThreads) {
+		for (int taskIndex = 0; taskIndex < numTasks; ++taskIndex)
+			graph.m_tasks[taskIndex].function();
+		return;
+	}
+
+	// the graph keeps its run state, so running it again doesn't allocate
+	if (numTasks > graph.m_maxPendingDependencies) {
+		graph.m_pendingDependencies.reset(new std::atomic<int>[numTasks]);
+		graph.m_maxPendingDependencies = numTasks;
+	}
+	graph.m_jobs.resize(numTasks);
+	graph.m_jobSystem = this;
+
+	std::atomic<int> unfinished(numTasks);
+	for (int taskIndex = 0; taskIndex < numTasks; ++taskIndex) {
+		graph.m_pendingDependencies[taskIndex].store(graph.m_tasks[taskIndex].numDependencies);
+
+		job_t& job = graph.m_jobs[taskIndex];
+		job.function = RunGraphJob;
+		job.userData = &graph;
+		job.begin = taskIndex;
+		job.end = taskIndex + 1;
+		job.unfinished = &unfinished;
+	}
+
+	for (int taskIndex = numTasks - 1; taskIndex >= 0; --taskIndex) {
+		if (0 == graph.m_tasks[taskIndex].numDependencies)
+			Push(&graph.m_jobs[taskIndex]);
+	}
+
+	WaitFor(unfinished);
+}
@@ -0,0 +1,144 @@
+//
+//  JobSystem.h
+//
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskGraph;
+
+/*
+====================================================
+JobSystem
+// Work-stealing scheduler. Every worker owns a deque, it pushes and pops
+// its own jobs from the back and steals the oldest jobs from the front
+// of the other deques. Threads that aren't workers of the pool, like the
+// one calling Run/ParallelFor or a worker of another pool, share deque 0
+// as a submission queue and help out until their work is finished.
+====================================================
+*/
+class JobSystem {
+public:
+	explicit JobSystem( const int numThreads );
+	~JobSystem();
+
+	int GetNumThreads() const { return m_numThreads; }
+	int GetThreadIndex() const;	// of the calling thread in this pool, 0 for threads that aren't its workers
+
+	// Calls function( begin, end ) over [0, count) in batches of at least minBatchSize
+	void ParallelFor( const int count, const int minBatchSize, const std::function< void( int, int ) > & function );
+
+	// Runs every task of the graph and returns when all of them are finished
+	void Run( TaskGraph & graph );
+
+private:
+	friend class TaskGraph;
+
+	struct job_t {
+		void ( *function )( job_t & job );
+		void * userData;
+		int begin;
+		int end;
+		std::atomic< int > * unfinished;	// decremented once the job is done
+	};
+
+	struct worker_t {
+		std::mutex mutex;
+		std::deque< job_t * > jobs;
+	};
+
+	void Push( job_t * job );
+	job_t * Pop( const int threadIndex );
+	job_t * Steal( const int threadIndex );
+	bool RunOne( const int threadIndex );
+	void WaitFor( const std::atomic< int > & unfinished );
+	void WorkerMain( const int threadIndex );
+
+	static void RunParallelForJob( job_t & job );
+	static void RunGraphJob( job_t & job );
+
+	int m_numThreads;
+	worker_t * m_workers;
+	std::vector< std::thread > m_threads;
+
+	std::atomic< int > m_numQueued;
+	std::atomic< bool > m_quit;
+	std::mutex m_wakeMutex;
+	std::condition_variable m_wakeCondition;
+};
+
+/*
+====================================================
+TaskGraph
+// Tasks run once all of the tasks they depend on have finished.
+// A task may only depend on tasks that were added before it. The graph
+// keeps the bookkeeping of its runs, so a graph built once and run every
+// step doesn't allocate. It runs on one job system at a time.
+====================================================
+*/
+class TaskGraph {
+public:
+	TaskGraph() : m_jobSystem( NULL ), m_maxPendingDependencies( 0 ) {}
+
+	int AddTask( const char * name, const std::function< void() > & function );
+	void AddDependency( const int task, const int dependsOn );
+	void Clear();
+
+	int GetNumTasks() const { return static_cast< int >( m_tasks.size() ); }
+
+private:
+	friend class JobSystem;
+
+	struct task_t {
+		const char * name;
+		std::function< void() > function;
+		std::vector< int > dependents;
+		int numDependencies;
+	};
+	std::vector< task_t > m_tasks;
+
+	// per run, only grown
+	JobSystem * m_jobSystem;
+	std::vector< JobSystem::job_t > m_jobs;
+	std::unique_ptr< std::atomic< int >[] > m_pendingDependencies;
+	int m_maxPendingDependencies;
+};
+
+/*
+====================================================
+ParallelReduce
+// The range is cut into batches of a fixed size no matter how many threads
+// there are and the batch results are combined in batch order, so the result
+// is bitwise identical on any thread count. A NULL job system runs serially.
+====================================================
+*/
+template< typename T, typename MapFunction, typename CombineFunction >
+T ParallelReduce( JobSystem * jobSystem, const int count, const int batchSize, const T & identity, const MapFunction & map, const CombineFunction & combine ) {
+	const int numBatches = ( count + batchSize - 1 ) / batchSize;
+	std::vector< T > batchResults( numBatches, identity );
+
+	auto mapBatches = [ & ]( int begin, int end ) {
+		for ( int batchIndex = begin; batchIndex < end; ++batchIndex ) {
+			const int first = batchIndex * batchSize;
+			const int last = ( first + batchSize < count ) ? ( first + batchSize ) : count;
+			batchResults[ batchIndex ] = map( first, last );
+		}
+	};
+	if ( NULL != jobSystem ) {
+		jobSystem->ParallelFor( numBatches, 1, mapBatches );
+	} else {
+		mapBatches( 0, numBatches );
+	}
+
+	T result = identity;
+	for ( int batchIndex = 0; batchIndex < numBatches; ++batchIndex ) {
+		result = combine( result, batchResults[ batchIndex ] );
+	}
+	return result;
+}
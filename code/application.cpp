@@ -16,41 +16,18 @@
 #include "Renderer/OffscreenRenderer.h"
 
 #include "Scene.h"
+#include "Clock.h"
+#include "Profiler/Profiler.h"
 
 Application * g_application = NULL;
 
-#include <time.h>
-#include <windows.h>
-
-static bool gIsInitialized( false );
-static unsigned __int64 gTicksPerSecond;
-static unsigned __int64 gStartTicks;
-
 /*
 ====================================
-GetTimeSeconds
+GetTimeMicroseconds
 ====================================
 */
-int GetTimeMicroseconds() {
-	if ( false == gIsInitialized ) {
-		gIsInitialized = true;
-
-		// Get the high frequency counter's resolution
-		QueryPerformanceFrequency( (LARGE_INTEGER *)&gTicksPerSecond );
-
-		// Get the current time
-		QueryPerformanceCounter( (LARGE_INTEGER *)&gStartTicks );
-
-		return 0;
-	}
-
-	unsigned __int64 tick;
-	QueryPerformanceCounter( (LARGE_INTEGER *)&tick );
-
-	const double ticks_per_micro = (double)( gTicksPerSecond / 1000000 );
-
-	const unsigned __int64 timeMicro = (unsigned __int64)( (double)( tick - gStartTicks ) / ticks_per_micro );
-	return (int)timeMicro;
+int64_t GetTimeMicroseconds() {
+	return GetTimeNanoseconds() / 1000;
 }
 
 /*
@@ -437,6 +414,14 @@ void Application::Keyboard( int key, int scancode, int action, int modifiers ) {
 	if ( GLFW_KEY_Y == key && ( GLFW_PRESS == action || GLFW_REPEAT == action ) ) {
 		m_stepFrame = m_isPaused && !m_stepFrame;
 	}
+	if ( GLFW_KEY_B == key && GLFW_RELEASE == action ) {
+		// the budget trades accuracy for frame time, so it's off unless asked for
+		m_isBudgeted = !m_isBudgeted;
+		if ( !m_isBudgeted ) {
+			m_scene->ClearDegradation();
+		}
+		printf( "physics budget %s\n", m_isBudgeted ? "on" : "off" );
+	}
 
 	if (GLFW_KEY_V == key && GLFW_RELEASE == action) {
 		m_isDebug = !m_isDebug; // Toggle debug flag
@@ -453,14 +438,12 @@ Application::MainLoop
 ====================================================
 */
 void Application::MainLoop() {
-	static int timeLastFrame = 0;
-	static int numSamples = 0;
-	static float avgTime = 0.0f;
-	static float maxTime = 0.0f;
+	static int64_t timeLastFrame = 0;
+	static int64_t timeLastReport = 0;
 
 	while ( !glfwWindowShouldClose( m_glfwWindow ) ) {
-		int time					= GetTimeMicroseconds();
-		float dt_us					= (float)time - (float)timeLastFrame;
+		int64_t time				= GetTimeMicroseconds();
+		float dt_us					= (float)( time - timeLastFrame );
 		if ( dt_us < 16000.0f ) {
 			int x = 16000 - (int)dt_us;
 			std::this_thread::sleep_for( std::chrono::microseconds( x ) );
@@ -468,49 +451,47 @@ void Application::MainLoop() {
 			time = GetTimeMicroseconds();
 		}
 		timeLastFrame = time;
-		printf( "\ndt_ms: %.1f    ", dt_us * 0.001f );
 
 		// Get User Input
 		glfwPollEvents();
 
-		// If the time is greater than 33ms (30fps)
-		// then force the time difference to smaller
-		// to prevent super large simulation steps.
-		if ( dt_us > 33000.0f ) {
-			dt_us = 33000.0f;
-		}
-
+		// Large time differences are capped by the scene's
+		// maximum number of fixed steps per frame.
 		bool runPhysics = true;
 		if ( m_isPaused ) {
 			dt_us = 0.0f;
 			runPhysics = false;
 			if ( m_stepFrame ) {
-				dt_us = 16667.0f;
+				dt_us = m_scene->GetFixedDeltaSecond() * 1000.0f * 1000.0f;
 				m_stepFrame = false;
 				runPhysics = true;
 			}
-			numSamples = 0;
-			maxTime = 0.0f;
 		}
 		float dt_sec = dt_us * 0.001f * 0.001f;
 
-		// Run Update
+		// Run Update, with the budget it leaves about half of the 16ms frame for drawing
 		if ( runPhysics ) {
-			int startTime = GetTimeMicroseconds();
-			for ( int i = 0; i < 2; i++ ) {
-				m_scene->Update( dt_sec * 0.5f );
-			}
-			int endTime = GetTimeMicroseconds();
-
-			dt_us = (float)endTime - (float)startTime;
-			if ( dt_us > maxTime ) {
-				maxTime = dt_us;
+			PROFILE_SCOPE( "Step" );
+			if ( m_isBudgeted ) {
+				m_scene->StepWithBudget( dt_sec, 0.008f );
+			} else {
+				m_scene->Step( dt_sec );
 			}
+		}
 
-			avgTime = ( avgTime * float( numSamples ) + dt_us ) / float( numSamples + 1 );
-			numSamples++;
+		// Report the physics timings once a second instead of every frame
+		if ( time - timeLastReport > 1000 * 1000 ) {
+			timeLastReport = time;
 
-			printf( "frame dt_ms: %.2f %.2f %.2f", avgTime * 0.001f, maxTime * 0.001f, dt_us * 0.001f );
+			zoneStats_t stats;
+			if ( Profiler::GetZoneStats( "Update", stats ) && stats.count > 0 ) {
+				printf( "update ms  avg: %.3f  max: %.3f  p99: %.3f  (%lld steps)\n",
+					stats.avg * 1.0e-6, double( stats.max ) * 1.0e-6, double( stats.p99 ) * 1.0e-6, (long long)stats.count );
+			}
+			if ( 0 != m_scene->GetDegradations() ) {
+				printf( "over the physics budget, degradations: 0x%x\n", m_scene->GetDegradations() );
+			}
+			Profiler::Reset();
 		}
 
 		// Draw the Scene
@@ -625,13 +606,16 @@ void Application::UpdateUniforms() {
 		//	Update the uniform buffer with the body positions/orientations
 		//
 		for ( int i = 0; i < m_scene->m_bodies.size(); i++ ) {
-			Body & body = m_scene->m_bodies[ i ];
+			// blend between the last two physics steps so rendering stays smooth at any step rate
+			Vec3 position;
+			Quat orientation;
+			m_scene->GetInterpolatedTransform( i, position, orientation );
 
-			Vec3 fwd = body.m_orientation.RotatePoint( Vec3( 1, 0, 0 ) );
-			Vec3 up = body.m_orientation.RotatePoint( Vec3( 0, 0, 1 ) );
+			Vec3 fwd = orientation.RotatePoint( Vec3( 1, 0, 0 ) );
+			Vec3 up = orientation.RotatePoint( Vec3( 0, 0, 1 ) );
 
 			Mat4 matOrient;
-			matOrient.Orient( body.m_position, fwd, up );
+			matOrient.Orient( position, fwd, up );
 			matOrient = matOrient.Transpose();
 
 			// Update the uniform buffer with the orientation of this body
@@ -641,8 +625,8 @@ void Application::UpdateUniforms() {
 			renderModel.model = m_models[ i ];
 			renderModel.uboByteOffset = uboByteOffset;
 			renderModel.uboByteSize = sizeof( matOrient );
-			renderModel.pos = body.m_position;
-			renderModel.orient = body.m_orientation;
+			renderModel.pos = position;
+			renderModel.orient = orientation;
 			m_renderModels.push_back( renderModel );
 
 			uboByteOffset += m_deviceContext.GetAligendUniformByteOffset( sizeof( matOrient ) );
@@ -26,7 +26,7 @@ Application
 */
 class Application {
 public:
-	Application() : m_isPaused( true ), m_stepFrame( false ) {}
+	Application() : m_isPaused( true ), m_stepFrame( false ), m_isBudgeted( false ) {}
 	~Application();
 
 	void Initialize();
@@ -84,6 +84,7 @@ private:
 	bool m_isPaused;
 	bool m_stepFrame;
 	bool m_isDebug;
+	bool m_isBudgeted;	// StepWithBudget instead of Step, toggled with B
 
 	std::vector< RenderModel > m_renderModels;
 